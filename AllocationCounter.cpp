@@ -0,0 +1,96 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+
+namespace
+{
+	std::atomic<uint64_t> allocated{0};
+}
+
+#if defined(__GLIBC__) && defined(COUNT_ALLOCATIONS)
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+	void* __libc_valloc(size_t size);
+	void* __libc_pvalloc(size_t size);
+	void __libc_free(void* ptr);
+
+	void* malloc(size_t size) noexcept
+	{
+		allocated.fetch_add(1, std::memory_order_relaxed);
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size) noexcept
+	{
+		allocated.fetch_add(1, std::memory_order_relaxed);
+		return __libc_calloc(count, size);
+	}
+
+	void* realloc(void* ptr, size_t size) noexcept
+	{
+		allocated.fetch_add(1, std::memory_order_relaxed);
+		return __libc_realloc(ptr, size);
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size) noexcept
+	{
+		allocated.fetch_add(1, std::memory_order_relaxed);
+		return __libc_memalign(alignment, size);
+	}
+
+	void* memalign(size_t alignment, size_t size) noexcept
+	{
+		allocated.fetch_add(1, std::memory_order_relaxed);
+		return __libc_memalign(alignment, size);
+	}
+
+	void* valloc(size_t size) noexcept
+	{
+		allocated.fetch_add(1, std::memory_order_relaxed);
+		return __libc_valloc(size);
+	}
+
+	void* pvalloc(size_t size) noexcept
+	{
+		allocated.fetch_add(1, std::memory_order_relaxed);
+		return __libc_pvalloc(size);
+	}
+
+	int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept
+	{
+		// Same contract as glibc: a power of two multiple of sizeof(void*), *ptr untouched otherwise
+		if(alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0)
+		{
+			return EINVAL;
+		}
+		allocated.fetch_add(1, std::memory_order_relaxed);
+		*ptr = __libc_memalign(alignment, size);
+		return *ptr || size == 0 ? 0 : ENOMEM;
+	}
+
+	void free(void* ptr) noexcept
+	{
+		__libc_free(ptr);
+	}
+}
+#endif
+
+bool allocations::supported() noexcept
+{
+#if defined(__GLIBC__) && defined(COUNT_ALLOCATIONS)
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint64_t allocations::count() noexcept
+{
+	return allocated.load(std::memory_order_relaxed);
+}
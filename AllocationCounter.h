@@ -0,0 +1,24 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+// Process wide heap allocation counter. Built with COUNT_ALLOCATIONS (make ALLOCATIONS=1)
+// on glibc, malloc and friends are interposed, so operator new, std containers and Eigen's
+// aligned buffers are all counted. Other builds leave the allocator alone.
+namespace allocations
+{
+	// False when the allocator is not hooked and count() stays 0
+	bool supported() noexcept;
+	uint64_t count() noexcept;
+
+	// Allocations made since construction (by every thread)
+	struct Scope
+	{
+		uint64_t start = allocations::count();
+
+		uint64_t count() const noexcept { return allocations::count() - start; }
+	};
+};
+
+#endif // ALLOCATION_COUNTER_H
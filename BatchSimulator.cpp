@@ -0,0 +1,179 @@
+#include "BatchSimulator.h"
+
+BatchSimulator::BatchSimulator(const SnakeData& problem, const uint32_t sim_time) :
+	problems(1, problem),
+	quantized(problem.quantized),
+	input_scale(problem.inputScale()),
+	sim_time(sim_time) {}
+
+void BatchSimulator::run(const uint32_t count, std::vector<double>& fitnesses, const uint32_t generation, const uint32_t episode)
+{
+	std::uniform_int_distribution<uint32_t> pos_x(1, problems.front().width-2), pos_y(1, problems.front().height-2);
+	for(uint32_t lane = 0; lane < count; ++lane)
+	{
+		lanes[lane] = lane;
+		auto& problem = problems[lane];
+		problem.rng = random::stream(generation, genomes[lane], episode, random::Purpose::SIMULATION);
+		const auto x = pos_x(problem.rng);
+		snakes[lane].respawn(x, pos_y(problem.rng));
+		problem.reset(snakes[lane]);
+	}
+
+	Eigen::Index active = count;
+	for(uint32_t step = 0; step < sim_time && active > 0; ++step)
+	{
+		steps += active;
+		if(quantized)
+		{
+			// Sensors write fixed point straight into the int16 inputs
+			auto& inputs = qactivations.front();
+			for(Eigen::Index slot = 0; slot < active; ++slot)
+			{
+				const auto lane = lanes[slot];
+				snakes[lane].sense(problems[lane], inputs.row(slot), input_scale);
+			}
+			forwardQuantized(active);
+		}
+		else
+		{
+			auto& inputs = activations.front();
+			for(Eigen::Index slot = 0; slot < active; ++slot)
+			{
+				const auto lane = lanes[slot];
+				snakes[lane].sense(problems[lane], inputs.row(slot));
+			}
+			forward(active);
+		}
+		for(Eigen::Index slot = 0; slot < active; ++slot)
+		{
+			const auto lane = lanes[slot];
+			snakes[lane].advance(static_cast<Snake::Actions>(decision(slot)));
+			alive[slot] = problems[lane].resolve(snakes[lane]);
+		}
+		// Move finished episodes behind the active rows
+		for(Eigen::Index slot = 0; slot < active;)
+		{
+			if(alive[slot]) ++slot;
+			else swapSlots(slot, --active);
+		}
+	}
+
+	episodes += count;
+	timeouts += active;
+	for(uint32_t lane = 0; lane < count; ++lane)
+	{
+		fitnesses[genomes[lane]] = snakes[lane].score;
+	}
+}
+
+void BatchSimulator::forward(const Eigen::Index active)
+{
+	for(uint32_t l = 0; l < layers.size(); ++l)
+	{
+		const auto in = activations[l].topRows(active);
+		auto out = activations[l + 1].topRows(active);
+		const Eigen::Index in_size = in.cols();
+		for(Eigen::Index j = 0; j < out.cols(); ++j)
+		{
+			out.col(j) = (in.array() * layers[l].block(0, j * in_size, active, in_size).array()).rowwise().sum();
+		}
+		if(l + 1 < layers.size())
+		{
+			out = sigmoid(out).matrix();
+		}
+	}
+}
+
+void BatchSimulator::forwardQuantized(const Eigen::Index active)
+{
+	float in_scale = input_scale;
+	for(uint32_t l = 0; l < qlayers.size(); ++l)
+	{
+		const auto& in = qactivations[l];
+		const Eigen::Index in_size = in.cols();
+		const Eigen::Index out_size = qlayers[l].cols() / in_size;
+		// Blocks of contiguous rows, so the sums of a block stay in registers over all inputs.
+		// Rows are padded to whole blocks, the rows past active only compute unused sums.
+		// Columns are addressed through their strides, the inner loop runs once per product.
+		const Eigen::Index x_stride = in.rows(), w_stride = qlayers[l].rows(), out_stride = sums.rows();
+		const int16_t* x = in.data();
+		const int8_t* w = qlayers[l].data();
+		int32_t* out = sums.data();
+		for(Eigen::Index b = 0; b < active; b += block)
+		{
+			for(Eigen::Index j = 0; j < out_size; ++j)
+			{
+				int32_t acc[block] = {};
+				const int8_t* wj = w + j * in_size * w_stride;
+				for(Eigen::Index i = 0; i < in_size; ++i)
+				{
+					quantization::accumulate(x + i * x_stride + b, wj + i * w_stride + b, acc, block);
+				}
+				int32_t* sum = out + j * out_stride + b;
+				for(Eigen::Index k = 0; k < block; ++k)
+				{
+					sum[k] = acc[k];
+				}
+			}
+		}
+		if(l + 1 == qlayers.size())
+		{
+			// Argmax over the contiguous output columns, lane by lane, with the running maximum
+			// in the first column; strict > keeps the first index on ties like maxCoeff
+			int32_t* best = sums.col(0).data();
+			std::fill_n(actions.begin(), active, 0);
+			for(Eigen::Index j = 1; j < out_size; ++j)
+			{
+				const int32_t* sum = sums.col(j).data();
+				for(Eigen::Index slot = 0; slot < active; ++slot)
+				{
+					const bool better = sum[slot] > best[slot];
+					best[slot] = better ? sum[slot] : best[slot];
+					actions[slot] = better ? j : actions[slot];
+				}
+			}
+			break;
+		}
+		// Same lookup as QuantizedNetwork, so both get the same fixed point activations
+		const int32_t* table = quantization::sigmoidTable();
+		auto& next = qactivations[l + 1];
+		const float* scale = qscales.col(l).data();
+		for(Eigen::Index j = 0; j < out_size; ++j)
+		{
+			const int32_t* sum = sums.col(j).data();
+			int16_t* activation = next.col(j).data();
+			for(Eigen::Index slot = 0; slot < active; ++slot)
+			{
+				activation[slot] = quantization::activate(sum[slot] * (scale[slot] / in_scale), table);
+			}
+		}
+		in_scale = quantization::activation_scale;
+	}
+}
+
+Eigen::Index BatchSimulator::decision(const Eigen::Index slot) const
+{
+	if(quantized) return actions[slot];
+	Eigen::Index ind;
+	activations.back().row(slot).maxCoeff(&ind);
+	return ind;
+}
+
+void BatchSimulator::swapSlots(const Eigen::Index a, const Eigen::Index b)
+{
+	if(a == b) return;
+	std::swap(lanes[a], lanes[b]);
+	std::swap(alive[a], alive[b]);
+	for(auto& layer : layers)
+	{
+		layer.row(a).swap(layer.row(b));
+	}
+	if(quantized)
+	{
+		for(auto& layer : qlayers)
+		{
+			layer.row(a).swap(layer.row(b));
+		}
+		qscales.row(a).swap(qscales.row(b));
+	}
+}
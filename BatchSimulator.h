@@ -0,0 +1,171 @@
+#ifndef BATCH_SIMULATOR_H
+#define BATCH_SIMULATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <eigen3/Eigen/Core>
+#include "NeuralNetwork.h"
+#include "Quantization.h"
+#include "Snake.h"
+
+// Advances a batch of snakes in lockstep. Sensor inputs of all live snakes are gathered
+// into one matrix and every layer of every network is evaluated with one strided product
+// per output neuron. Finished episodes are compacted out of the active rows. Only the argmax
+// of the outputs is used, so the output activation is skipped. With a quantized problem the
+// weights are int8 in the same layout, sensors write int16 fixed point inputs and the
+// products run on integers.
+// All buffers only ever grow, so after the first batch evaluation never allocates.
+struct BatchSimulator
+{
+	using Matrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>;
+
+	std::vector<SnakeData> problems;
+	std::vector<Snake> snakes;
+	// lanes[slot] - lane owning active row slot, genomes[lane] - its population index
+	std::vector<uint32_t> lanes;
+	std::vector<uint32_t> genomes;
+	std::vector<char> alive;
+	// Per layer: one row per active genome, column j*in + i holds weight (i, j)
+	std::vector<Matrix> layers;
+	// activations[0] are inputs, activations[L + 1] outputs of layer L
+	std::vector<Matrix> activations;
+	// Quantized counterparts: int8 layers with a scale per row and layer, fixed point inputs
+	// of every layer and the integer sums of the current layer
+	std::vector<Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic>> qlayers;
+	Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> qscales;
+	std::vector<Eigen::Matrix<int16_t, Eigen::Dynamic, Eigen::Dynamic>> qactivations;
+	Eigen::Matrix<int32_t, Eigen::Dynamic, Eigen::Dynamic> sums;
+	// Rows the quantized products handle at once; quantized matrices have whole blocks of rows
+	static constexpr Eigen::Index block = 32;
+	// Quantized decisions of the active rows. Every sum of a row has the same positive
+	// scale, so they rank like the real outputs.
+	std::vector<uint32_t> actions;
+	bool quantized;
+	// Fixed point scale of quantized inputs, chosen for the board
+	float input_scale;
+	uint32_t sim_time;
+	// Snake steps simulated so far, episodes played and those cut off at sim_time
+	uint64_t steps = 0;
+	uint64_t episodes = 0;
+	uint64_t timeouts = 0;
+
+	BatchSimulator(const SnakeData& problem, const uint32_t sim_time);
+
+	// Plays one episode for each of population[begin, end) and stores scores in fitnesses.
+	// population is a Population or a std::vector of networks. Genome i plays on
+	// random::stream(generation, i, episode, SIMULATION), independent of how genomes are batched.
+	template<typename Networks>
+	void evaluate(const Networks& population, const uint32_t begin, const uint32_t end, std::vector<double>& fitnesses, const uint32_t generation, const uint32_t episode = 0);
+	// Same for the count genomes listed in indices, score of genome i goes to fitnesses[i]
+	template<typename Networks>
+	void evaluate(const Networks& population, const uint32_t* indices, const uint32_t count, std::vector<double>& fitnesses, const uint32_t generation, const uint32_t episode = 0);
+
+private:
+	template<typename Networks>
+	void play(const Networks& population, const uint32_t count, std::vector<double>& fitnesses, const uint32_t generation, const uint32_t episode);
+	template<typename Network>
+	void reserve(const uint32_t count, const Network& nn);
+	void run(const uint32_t count, std::vector<double>& fitnesses, const uint32_t generation, const uint32_t episode);
+	void forward(const Eigen::Index active);
+	void forwardQuantized(const Eigen::Index active);
+	// Action of the network in row slot after the forward pass
+	Eigen::Index decision(const Eigen::Index slot) const;
+	void swapSlots(const Eigen::Index a, const Eigen::Index b);
+};
+
+template<typename Networks>
+inline void BatchSimulator::evaluate(const Networks& population, const uint32_t begin, const uint32_t end, std::vector<double>& fitnesses, const uint32_t generation, const uint32_t episode)
+{
+	const uint32_t count = end - begin;
+	if(count == 0) return;
+	reserve(count, population[begin]);
+	for(uint32_t lane = 0; lane < count; ++lane)
+	{
+		genomes[lane] = begin + lane;
+	}
+	play(population, count, fitnesses, generation, episode);
+}
+
+template<typename Networks>
+inline void BatchSimulator::evaluate(const Networks& population, const uint32_t* indices, const uint32_t count, std::vector<double>& fitnesses, const uint32_t generation, const uint32_t episode)
+{
+	if(count == 0) return;
+	reserve(count, population[indices[0]]);
+	std::copy(indices, indices + count, genomes.begin());
+	play(population, count, fitnesses, generation, episode);
+}
+
+template<typename Networks>
+inline void BatchSimulator::play(const Networks& population, const uint32_t count, std::vector<double>& fitnesses, const uint32_t generation, const uint32_t episode)
+{
+	for(uint32_t lane = 0; lane < count; ++lane)
+	{
+		const auto nn = population[genomes[lane]];
+		for(uint32_t l = 0; l < layers.size(); ++l)
+		{
+			const auto layer = nn.layer(l);
+			if(quantized)
+			{
+				auto& q = qlayers[l];
+				qscales(lane, l) = quantization::quantize(layer.data(), layer.size(), q.data() + lane, q.rows());
+			}
+			else
+			{
+				layers[l].row(lane) = Eigen::Map<const Eigen::RowVectorXf>(layer.data(), layer.size());
+			}
+		}
+	}
+	run(count, fitnesses, generation, episode);
+}
+
+template<typename Network>
+inline void BatchSimulator::reserve(const uint32_t count, const Network& nn)
+{
+	// problems starts with the template copy, so test the lane buffers
+	if(lanes.size() < count)
+	{
+		problems.resize(std::max<size_t>(problems.size(), count), problems.front());
+		snakes.resize(count);
+		lanes.resize(count);
+		genomes.resize(count);
+		alive.resize(count);
+	}
+	const Eigen::Index capacity = problems.size();
+	const auto fit = [capacity](auto& m, const Eigen::Index cols)
+	{
+		if(m.rows() < capacity || m.cols() != cols) m.resize(capacity, cols);
+	};
+	layers.resize(nn.layersCount() - 1);
+	activations.resize(nn.layersCount());
+	// Quantized inputs are sensed straight into qactivations
+	fit(activations.front(), quantized ? 0 : nn.layer(0).rows());
+	Eigen::Index widest = 0;
+	for(uint32_t l = 0; l < layers.size(); ++l)
+	{
+		const auto layer = nn.layer(l);
+		fit(layers[l], quantized ? 0 : layer.size());
+		fit(activations[l + 1], layer.cols());
+		widest = std::max(widest, layer.cols());
+	}
+	if(!quantized) return;
+	// Zeroed, so the padding rows hold defined values
+	const Eigen::Index rows = (capacity + block - 1) / block * block;
+	const auto qfit = [rows](auto& m, const Eigen::Index cols)
+	{
+		if(m.rows() < rows || m.cols() != cols) m.setZero(rows, cols);
+	};
+	qlayers.resize(layers.size());
+	qactivations.resize(layers.size());
+	for(uint32_t l = 0; l < layers.size(); ++l)
+	{
+		const auto layer = nn.layer(l);
+		qfit(qlayers[l], layer.size());
+		qfit(qactivations[l], layer.rows());
+	}
+	fit(qscales, layers.size());
+	qfit(sums, widest);
+	actions.resize(capacity);
+}
+
+#endif // BATCH_SIMULATOR_H
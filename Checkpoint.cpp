@@ -0,0 +1,169 @@
+#include "Checkpoint.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	// Genome rows start on a cache line, like the in-memory arena
+	constexpr uint64_t data_alignment = 64;
+
+	bool writeAll(const int fd, const void* data, size_t size)
+	{
+		const char* bytes = static_cast<const char*>(data);
+		while(size > 0)
+		{
+			const auto written = ::write(fd, bytes, size);
+			if(written < 0)
+			{
+				if(errno == EINTR) continue;
+				return false;
+			}
+			bytes += written;
+			size -= written;
+		}
+		return true;
+	}
+
+	// nullptr when the mapped bytes hold a complete checkpoint, the reason otherwise
+	const char* validate(const std::byte* data, const size_t length)
+	{
+		using namespace checkpoint;
+		if(length < sizeof(Header)) return "truncated header";
+		const auto& h = *reinterpret_cast<const Header*>(data);
+		if(std::memcmp(h.magic, magic, sizeof(h.magic)) != 0) return "bad magic";
+		if(h.version != version) return "unsupported version";
+		if(h.layers < 2 || h.layers > max_layers) return "bad layer count";
+		uint64_t genome_length = 0;
+		for(uint32_t l = 0; l + 1 < h.layers; ++l)
+		{
+			genome_length += uint64_t(h.sizes[l]) * h.sizes[l + 1];
+		}
+		if(h.stride < genome_length) return "rows shorter than the genome";
+		if(h.genomes_offset % data_alignment || h.genomes_offset + uint64_t(h.genomes) * h.stride * sizeof(float) > length) return "truncated genomes";
+		if(h.fitnesses_offset + uint64_t(h.genomes) * sizeof(double) > length) return "truncated fitnesses";
+		return nullptr;
+	}
+}
+
+checkpoint::Mapped::Mapped(const std::string& path)
+{
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		message = fmt::format("cannot open {}: {}", path, std::strerror(errno));
+		return;
+	}
+	found = true;
+	struct stat info;
+	void* mapping = MAP_FAILED;
+	if(::fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	::close(fd);
+	if(mapping == MAP_FAILED)
+	{
+		message = fmt::format("cannot map {}", path);
+		return;
+	}
+	data = static_cast<const std::byte*>(mapping);
+	length = info.st_size;
+
+	if(const char* reason = validate(data, length))
+	{
+		message = fmt::format("{} is not a valid checkpoint: {}", path, reason);
+		::munmap(const_cast<std::byte*>(data), length);
+		data = nullptr;
+		length = 0;
+		return;
+	}
+	layout.emplace(header().sizes, header().sizes + header().layers);
+}
+
+checkpoint::Mapped::~Mapped()
+{
+	if(data)
+	{
+		::munmap(const_cast<std::byte*>(data), length);
+	}
+}
+
+const checkpoint::Header& checkpoint::Mapped::header() const noexcept
+{
+	return *reinterpret_cast<const Header*>(data);
+}
+
+const float* checkpoint::Mapped::genome(const uint32_t i) const noexcept
+{
+	return reinterpret_cast<const float*>(data + header().genomes_offset) + uint64_t(i) * header().stride;
+}
+
+NeuralNetworkView checkpoint::Mapped::network(const uint32_t i) const noexcept
+{
+	return {&*layout, genome(i)};
+}
+
+const double* checkpoint::Mapped::fitnesses() const noexcept
+{
+	return reinterpret_cast<const double*>(data + header().fitnesses_offset);
+}
+
+bool checkpoint::Mapped::matches(const Population& population) const noexcept
+{
+	return valid() && population.topology.sizes == layout->sizes && population.size() == header().genomes;
+}
+
+void checkpoint::Mapped::restore(Population& population, std::vector<double>& fitnesses) const
+{
+	assert(matches(population));
+	const uint32_t length = layout->genomeLength();
+	for(uint32_t i = 0; i < population.size(); ++i)
+	{
+		population.genome(i) = Eigen::Map<const Eigen::RowVectorXf>(genome(i), length);
+	}
+	fitnesses.assign(this->fitnesses(), this->fitnesses() + header().genomes);
+}
+
+bool checkpoint::save(const std::string& path, const Engine engine, const uint64_t generation, const Population& population, const std::vector<double>& fitnesses)
+{
+	assert(population.topology.layersCount() <= max_layers && fitnesses.size() == population.size());
+	Header h{};
+	std::memcpy(h.magic, checkpoint::magic, sizeof(h.magic));
+	h.version = checkpoint::version;
+	h.engine = engine;
+	h.run_seed = random::run_seed;
+	h.generation = generation;
+	h.layers = population.topology.layersCount();
+	std::copy(std::begin(population.topology.sizes), std::end(population.topology.sizes), h.sizes);
+	h.genomes = population.size();
+	h.stride = population.genomes.cols();
+	h.genomes_offset = (sizeof(Header) + data_alignment - 1) / data_alignment * data_alignment;
+	h.fitnesses_offset = h.genomes_offset + uint64_t(h.genomes) * h.stride * sizeof(float);
+
+	const std::string temp = path + ".tmp";
+	const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) return false;
+	const char padding[data_alignment] = {};
+	const bool written = writeAll(fd, &h, sizeof(h)) &&
+		writeAll(fd, padding, h.genomes_offset - sizeof(h)) &&
+		writeAll(fd, population.genomes.data(), h.fitnesses_offset - h.genomes_offset) &&
+		writeAll(fd, fitnesses.data(), fitnesses.size() * sizeof(double)) &&
+		::fsync(fd) == 0;
+	if(::close(fd) != 0 || !written)
+	{
+		::unlink(temp.c_str());
+		return false;
+	}
+	if(::rename(temp.c_str(), path.c_str()) != 0) return false;
+	// The rename itself is only durable once the directory entry is flushed
+	const auto slash = path.rfind('/');
+	const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+	const int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+	if(dir < 0) return false;
+	const bool synced = ::fsync(dir) == 0;
+	return ::close(dir) == 0 && synced;
+}
@@ -0,0 +1,88 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "NeuralNetwork.h"
+#include "Population.h"
+
+// When and where engines save their state. interval 0 never saves; with resume an existing
+// checkpoint at path is continued, a missing one starts a new run.
+struct Checkpointing
+{
+	std::string path;
+	uint32_t interval = 0;
+	bool resume = false;
+};
+
+// Versioned binary snapshot of a training run: header, population arena exactly as laid out
+// in memory (rows padded to stride floats) and one fitness per genome. Streams are keyed by
+// run seed and generation, so these two numbers are the whole random state of a run.
+namespace checkpoint
+{
+	constexpr char magic[8] = {'S', 'N', 'A', 'K', 'E', 'N', 'E', '\0'};
+	constexpr uint32_t version = 1;
+	constexpr uint32_t max_layers = 8;
+
+	enum class Engine : uint32_t
+	{
+		GENERATIONAL, STEADY, ASYNC, CROSS_ENTROPY, EVOLUTION_STRATEGIES
+	};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		Engine engine;
+		uint64_t run_seed;
+		// Generations, rounds or children completed, depending on the engine
+		uint64_t generation;
+		uint32_t layers;
+		uint32_t sizes[max_layers];
+		uint32_t genomes;
+		// Floats per population row
+		uint32_t stride;
+		// Byte offsets from the start of the file
+		uint64_t genomes_offset;
+		uint64_t fitnesses_offset;
+	};
+
+	// Read only mapping of a checkpoint, nothing is copied until restore()
+	struct Mapped
+	{
+		explicit Mapped(const std::string& path);
+		Mapped(const Mapped&) = delete;
+		Mapped& operator=(const Mapped&) = delete;
+		~Mapped();
+
+		bool exists() const noexcept { return found; }
+		// False when the file is missing or not a valid checkpoint, see error()
+		bool valid() const noexcept { return data != nullptr; }
+		const std::string& error() const noexcept { return message; }
+		const Header& header() const noexcept;
+		const Topology& topology() const noexcept { return *layout; }
+		const float* genome(const uint32_t i) const noexcept;
+		NeuralNetworkView network(const uint32_t i) const noexcept;
+		const double* fitnesses() const noexcept;
+		// True when population has the same topology and size as the checkpoint
+		bool matches(const Population& population) const noexcept;
+		void restore(Population& population, std::vector<double>& fitnesses) const;
+
+	private:
+		const std::byte* data = nullptr;
+		size_t length = 0;
+		std::optional<Topology> layout;
+		std::string message;
+		bool found = false;
+	};
+
+	// Atomically replaces path: writes path.tmp, flushes it to disk, renames it over path and
+	// flushes the directory, so a crash leaves the previous checkpoint intact. Returns false
+	// on I/O errors.
+	bool save(const std::string& path, const Engine engine, const uint64_t generation, const Population& population, const std::vector<double>& fitnesses);
+};
+
+#endif // CHECKPOINT_H
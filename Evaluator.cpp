@@ -0,0 +1,45 @@
+#include "Evaluator.h"
+
+Evaluator::Evaluator(const SnakeData& problem, const uint32_t sim_time, const uint32_t threads, const Racing racing, const Caching caching) :
+	pool(threads),
+	problems(pool.size(), problem),
+	batches(pool.size(), BatchSimulator(problem, sim_time)),
+	sim_time(sim_time),
+	racing(racing),
+	caching(caching),
+	cache(caching.capacity) {}
+
+uint32_t Evaluator::threads() const noexcept
+{
+	return pool.size();
+}
+
+uint64_t Evaluator::steps() const noexcept
+{
+	uint64_t res = 0;
+	for(const auto& batch : batches)
+	{
+		res += batch.steps;
+	}
+	return res;
+}
+
+uint64_t Evaluator::episodes() const noexcept
+{
+	uint64_t res = 0;
+	for(const auto& batch : batches)
+	{
+		res += batch.episodes;
+	}
+	return res;
+}
+
+uint64_t Evaluator::timeouts() const noexcept
+{
+	uint64_t res = 0;
+	for(const auto& batch : batches)
+	{
+		res += batch.timeouts;
+	}
+	return res;
+}
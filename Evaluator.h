@@ -0,0 +1,187 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "NeuralNetwork.h"
+#include "Snake.h"
+#include "BatchSimulator.h"
+#include "FitnessCache.h"
+#include "ThreadPool.h"
+
+// Successive halving: every genome plays episodes episodes, then the better half plays
+// episodes more, up to rounds times. The default is a single episode per genome.
+struct Racing
+{
+	uint32_t episodes = 1;
+	uint32_t rounds = 0;
+};
+
+// Runs fitness episodes on a pool of workers. Each worker owns a private copy of the
+// problem, so boards and reward placement never race between episodes.
+struct Evaluator
+{
+	ThreadPool pool;
+	std::vector<SnakeData> problems;
+	std::vector<BatchSimulator> batches;
+	uint32_t sim_time;
+	// Selects the episode streams, engines advance it once per generation
+	uint32_t generation = 0;
+	Racing racing;
+	Caching caching;
+	FitnessCache cache;
+
+	Evaluator(const SnakeData& problem, const uint32_t sim_time, const uint32_t threads = 1, const Racing racing = {}, const Caching caching = {});
+
+	uint32_t threads() const noexcept;
+	// Snake steps, episodes and episodes cut off at sim_time of population evaluations so far
+	uint64_t steps() const noexcept;
+	uint64_t episodes() const noexcept;
+	uint64_t timeouts() const noexcept;
+	// Single episode on the calling thread, continues the stream of the first problem; a
+	// quantized problem plays the int8 copy of nn like the batches do
+	template<typename Network>
+	double evaluate(const Network& nn);
+	// Races the networks of a Population or std::vector, fitness is the mean score over the
+	// episodes a genome played, lowered where needed so genomes dropped in a round rank
+	// below every genome that raced on. With caching, genomes seen before reuse or extend their
+	// cached statistics. Each worker runs its share of an episode as one lockstep
+	// batch; fitnesses is resized to match
+	template<typename Networks>
+	void evaluate(const Networks& population, std::vector<double>& fitnesses);
+
+	template<typename Network>
+	static double simulate(SnakeData& problem, const Network& nn, const uint32_t sim_time);
+
+private:
+	// Plays the given episode for every contender, scores are written to scores
+	template<typename Networks>
+	void play(const Networks& population, const uint32_t episode);
+
+	// Racing buffers, reused between evaluations
+	std::vector<uint32_t> contenders;
+	std::vector<uint32_t> played;
+	std::vector<double> scores;
+	std::vector<uint64_t> keys;
+};
+
+template<typename Network>
+inline double Evaluator::evaluate(const Network& nn)
+{
+	if(problems.front().quantized)
+	{
+		return simulate(problems.front(), QuantizedNetwork(nn, problems.front().inputScale()), sim_time);
+	}
+	return simulate(problems.front(), nn, sim_time);
+}
+
+template<typename Networks>
+inline void Evaluator::evaluate(const Networks& population, std::vector<double>& fitnesses)
+{
+	const uint32_t size = population.size();
+	fitnesses.assign(size, 0.0);
+	played.assign(size, 0);
+	scores.resize(size);
+	keys.resize(cache.enabled() ? size : 0);
+	contenders.clear();
+	for(uint32_t i = 0; i < size; ++i)
+	{
+		if(cache.enabled())
+		{
+			keys[i] = FitnessCache::fingerprint(population[i]);
+			const auto entry = cache.find(keys[i]);
+			if(entry && entry->episodes >= caching.episodes)
+			{
+				fitnesses[i] = entry->mean();
+				continue;
+			}
+		}
+		contenders.push_back(i);
+	}
+	for(uint32_t round = 0;; ++round)
+	{
+		for(uint32_t e = 0; e < racing.episodes; ++e)
+		{
+			play(population, round * racing.episodes + e);
+			for(const auto i : contenders)
+			{
+				fitnesses[i] += scores[i];
+			}
+		}
+		for(const auto i : contenders)
+		{
+			played[i] += racing.episodes;
+		}
+		if(round == racing.rounds || contenders.size() < 2) break;
+		// All contenders played equally often, so total scores rank them
+		const auto half = std::begin(contenders) + (contenders.size() + 1) / 2;
+		std::nth_element(std::begin(contenders), half, std::end(contenders), [&](const uint32_t a, const uint32_t b)
+		{
+			return fitnesses[a] > fitnesses[b];
+		});
+		contenders.erase(half, std::end(contenders));
+	}
+	for(uint32_t i = 0; i < size; ++i)
+	{
+		if(played[i] == 0) continue;
+		if(cache.enabled())
+		{
+			fitnesses[i] = cache.add(keys[i], fitnesses[i], played[i]).mean();
+		}
+		else
+		{
+			fitnesses[i] /= played[i];
+		}
+	}
+	if(racing.rounds == 0 || size == 0) return;
+	// From the last round down, the dropouts of each round keep their order but are shifted
+	// under the lowest genome that got further
+	double floor = std::numeric_limits<double>::infinity();
+	const uint32_t last = *std::max_element(std::begin(played), std::end(played));
+	for(uint32_t reached = last; reached > 0; reached -= racing.episodes)
+	{
+		double top = -std::numeric_limits<double>::infinity();
+		double low = std::numeric_limits<double>::infinity();
+		for(uint32_t i = 0; i < size; ++i)
+		{
+			if(played[i] != reached) continue;
+			top = std::max(top, fitnesses[i]);
+			low = std::min(low, fitnesses[i]);
+		}
+		const double shift = top < floor ? 0.0 : top - floor + 1.0;
+		for(uint32_t i = 0; i < size; ++i)
+		{
+			if(played[i] == reached) fitnesses[i] -= shift;
+		}
+		floor = std::min(floor, low - shift);
+	}
+}
+
+template<typename Networks>
+inline void Evaluator::play(const Networks& population, const uint32_t episode)
+{
+	const uint32_t count = contenders.size();
+	const uint32_t chunks = std::min<uint32_t>(pool.size(), count);
+	pool.parallel_for(chunks, [&](const uint32_t chunk, const uint32_t worker)
+	{
+		const uint32_t begin = count * chunk / chunks;
+		const uint32_t end = count * (chunk + 1) / chunks;
+		batches[worker].evaluate(population, contenders.data() + begin, end - begin, scores, generation, episode);
+	});
+}
+
+template<typename Network>
+inline double Evaluator::simulate(SnakeData& problem, const Network& nn, const uint32_t sim_time)
+{
+	std::uniform_int_distribution<uint32_t> pos_x(1, problem.width-2), pos_y(1, problem.height-2);
+	const auto x = pos_x(problem.rng);
+	BasicSnakeNN<Network> snake(x, pos_y(problem.rng), nn);
+	problem.reset(snake);
+	uint32_t step = 0;
+	for(; step < sim_time && problem.step(snake); ++step);
+	return snake.score;
+}
+
+#endif // EVALUATOR_H
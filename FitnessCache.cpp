@@ -0,0 +1,52 @@
+#include "FitnessCache.h"
+#include <algorithm>
+#include <cassert>
+
+FitnessCache::FitnessCache(const uint32_t capacity)
+{
+	if(capacity == 0) return;
+	uint32_t size = probes;
+	while(size < capacity) size <<= 1;
+	entries.resize(size);
+	mask = size - 1;
+}
+
+const FitnessCache::Entry* FitnessCache::find(const uint64_t key) noexcept
+{
+	if(!enabled()) return nullptr;
+	for(uint32_t p = 0; p < probes; ++p)
+	{
+		const auto& entry = entries[(key + p) & mask];
+		if(entry.episodes != 0 && entry.key == key)
+		{
+			++hits;
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+const FitnessCache::Entry& FitnessCache::add(const uint64_t key, const double total, const uint32_t episodes) noexcept
+{
+	assert(enabled());
+	Entry* victim = &entries[key & mask];
+	for(uint32_t p = 0; p < probes; ++p)
+	{
+		auto& entry = entries[(key + p) & mask];
+		if(entry.episodes != 0 && entry.key == key)
+		{
+			entry.total += total;
+			entry.episodes += episodes;
+			return entry;
+		}
+		if(entry.episodes < victim->episodes) victim = &entry;
+	}
+	*victim = {key, total, episodes};
+	return *victim;
+}
+
+void FitnessCache::clear() noexcept
+{
+	std::fill(std::begin(entries), std::end(entries), Entry{});
+	hits = 0;
+}
@@ -0,0 +1,77 @@
+#ifndef FITNESS_CACHE_H
+#define FITNESS_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <eigen3/Eigen/Core>
+
+// Genome caching: a genome whose cached statistics hold at least episodes episodes is not
+// played again. capacity 0 disables the cache.
+struct Caching
+{
+	uint32_t capacity = 0;
+	uint32_t episodes = 1;
+};
+
+// Episode statistics keyed by genome fingerprint. Open addressing over a power of two
+// table that is allocated once; when a probe window is full the entry with the fewest
+// episodes is evicted, so long lived genomes like elites stay cached.
+struct FitnessCache
+{
+	struct Entry
+	{
+		uint64_t key = 0;
+		double total = 0.0;
+		// 0 marks an empty entry
+		uint32_t episodes = 0;
+
+		double mean() const noexcept { return total / episodes; }
+	};
+
+	// Hits of find() so far
+	uint64_t hits = 0;
+
+	explicit FitnessCache(const uint32_t capacity = 0);
+
+	bool enabled() const noexcept { return !entries.empty(); }
+	// nullptr when the genome was never played
+	const Entry* find(const uint64_t key) noexcept;
+	// Adds episodes with the given total score, returns the accumulated statistics
+	const Entry& add(const uint64_t key, const double total, const uint32_t episodes) noexcept;
+	void clear() noexcept;
+
+	// Hash of the weight bits of every layer, equal only for bit identical genomes
+	template<typename Network>
+	static uint64_t fingerprint(const Network& nn) noexcept;
+
+private:
+	static constexpr uint32_t probes = 8;
+
+	std::vector<Entry> entries;
+	uint64_t mask = 0;
+};
+
+template<typename Network>
+inline uint64_t FitnessCache::fingerprint(const Network& nn) noexcept
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for(uint32_t l = 0; l + 1 < nn.layersCount(); ++l)
+	{
+		const auto layer = nn.layer(l);
+		const float* data = layer.data();
+		h = (h ^ layer.size()) * 0x100000001b3ull;
+		for(Eigen::Index i = 0; i < layer.size(); ++i)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, data + i, sizeof(bits));
+			h = (h ^ bits) * 0x100000001b3ull;
+		}
+	}
+	// splitmix64 finaliser, FNV alone leaves the low bits used for the slot poorly mixed
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+	return h ^ (h >> 31);
+}
+
+#endif // FITNESS_CACHE_H
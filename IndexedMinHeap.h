@@ -0,0 +1,118 @@
+#ifndef INDEXED_MIN_HEAP_H
+#define INDEXED_MIN_HEAP_H
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Binary min heap over a fixed set of slots, e.g. population indices. Keys stay addressable
+// by slot, so the worst slot is found in O(1) and replacing its key costs O(log n).
+// Equal keys are ordered by slot, so top() depends only on the keys, not on the history.
+template<typename Key>
+struct IndexedMinHeap
+{
+	IndexedMinHeap() = default;
+	explicit IndexedMinHeap(const std::vector<Key>& keys);
+
+	uint32_t size() const noexcept { return heap.size(); }
+	// Slot with the smallest key
+	uint32_t top() const noexcept { assert(!heap.empty()); return heap.front(); }
+	const Key& key(const uint32_t slot) const noexcept { return values[slot]; }
+	// Keys indexed by slot
+	const std::vector<Key>& keys() const noexcept { return values; }
+
+	// Replaces all keys and rebuilds the heap in O(n), reuses the buffers
+	void assign(const std::vector<Key>& keys);
+	void update(const uint32_t slot, const Key& key);
+
+private:
+	void siftUp(uint32_t pos);
+	void siftDown(uint32_t pos);
+	void place(const uint32_t pos, const uint32_t slot) noexcept;
+	bool less(const uint32_t a, const uint32_t b) const noexcept;
+
+	std::vector<Key> values;
+	// heap[pos] - slot stored at heap position pos, positions[slot] is its inverse
+	std::vector<uint32_t> heap;
+	std::vector<uint32_t> positions;
+};
+
+template<typename Key>
+inline IndexedMinHeap<Key>::IndexedMinHeap(const std::vector<Key>& keys)
+{
+	assign(keys);
+}
+
+template<typename Key>
+inline void IndexedMinHeap<Key>::assign(const std::vector<Key>& keys)
+{
+	values = keys;
+	heap.resize(values.size());
+	positions.resize(values.size());
+	for(uint32_t i = 0; i < heap.size(); ++i)
+	{
+		place(i, i);
+	}
+	for(uint32_t pos = heap.size() / 2; pos-- > 0;)
+	{
+		siftDown(pos);
+	}
+}
+
+template<typename Key>
+inline void IndexedMinHeap<Key>::update(const uint32_t slot, const Key& key)
+{
+	const bool decreased = key < values[slot];
+	values[slot] = key;
+	if(decreased) siftUp(positions[slot]);
+	else siftDown(positions[slot]);
+}
+
+template<typename Key>
+inline void IndexedMinHeap<Key>::siftUp(uint32_t pos)
+{
+	const uint32_t slot = heap[pos];
+	while(pos > 0)
+	{
+		const uint32_t parent = (pos - 1) / 2;
+		if(!less(slot, heap[parent])) break;
+		place(pos, heap[parent]);
+		pos = parent;
+	}
+	place(pos, slot);
+}
+
+template<typename Key>
+inline void IndexedMinHeap<Key>::siftDown(uint32_t pos)
+{
+	const uint32_t slot = heap[pos];
+	const uint32_t count = heap.size();
+	while(true)
+	{
+		uint32_t child = 2 * pos + 1;
+		if(child >= count) break;
+		if(child + 1 < count && less(heap[child + 1], heap[child])) ++child;
+		if(!less(heap[child], slot)) break;
+		place(pos, heap[child]);
+		pos = child;
+	}
+	place(pos, slot);
+}
+
+template<typename Key>
+inline void IndexedMinHeap<Key>::place(const uint32_t pos, const uint32_t slot) noexcept
+{
+	heap[pos] = slot;
+	positions[slot] = pos;
+}
+
+template<typename Key>
+inline bool IndexedMinHeap<Key>::less(const uint32_t a, const uint32_t b) const noexcept
+{
+	if(values[a] < values[b]) return true;
+	if(values[b] < values[a]) return false;
+	return a < b;
+}
+
+#endif // INDEXED_MIN_HEAP_H
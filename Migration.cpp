@@ -0,0 +1,254 @@
+#include "Migration.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fmt/core.h>
+#include "random.h"
+
+namespace
+{
+	// Slots and genome rows start on a cache line, so islands never share one
+	constexpr size_t line = 64;
+	// Reads given up on while a sender stays in the middle of a send, e.g. a stopped process
+	constexpr uint32_t max_attempts = 1024;
+
+	constexpr size_t align(const size_t size)
+	{
+		return (size + line - 1) / line * line;
+	}
+
+	// Settings of the run that owns the memory, filled by the first island to open it
+	struct Shared
+	{
+		std::atomic<uint32_t> islands;
+		std::atomic<uint32_t> migrants;
+		std::atomic<uint32_t> stride;
+		std::atomic<uint64_t> run_seed;
+		// Mailboxes open on the memory, the last one to close removes the name
+		std::atomic<uint32_t> attached;
+	};
+
+	// Fields are zero in fresh memory, the first island stores its value, the others compare
+	template<typename T>
+	bool claim(std::atomic<T>& field, const T value)
+	{
+		T expected = 0;
+		return field.compare_exchange_strong(expected, value) || expected == value;
+	}
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock free");
+}
+
+// Sequence is odd while the owner writes the slot, the fitnesses follow the header and the
+// genomes start at genomes_offset. Every send stamps the run seed and layout of its sender,
+// so a receiver never takes migrants a run with other settings left behind.
+struct Mailbox::Slot
+{
+	std::atomic<uint64_t> sequence;
+	std::atomic<uint64_t> generation;
+	std::atomic<uint64_t> run_seed;
+	std::atomic<uint64_t> layout;
+};
+
+Mailbox::Mailbox(const std::string& name, const Migration& migration, const uint32_t stride, const uint64_t run_seed) :
+	name(name),
+	slots(migration.islands),
+	capacity(migration.migrants),
+	stride(stride),
+	run_seed(run_seed),
+	layout((uint64_t(stride) << 40) | (uint64_t(capacity) << 20) | slots)
+{
+	genomes_offset = align(sizeof(Slot) + capacity * sizeof(double));
+	slot_size = align(genomes_offset + size_t(capacity) * stride * sizeof(float));
+	const size_t size = align(sizeof(Shared)) + slots * slot_size;
+	void* memory = MAP_FAILED;
+	if(name.empty())
+	{
+		memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	}
+	else
+	{
+		const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+		if(fd < 0)
+		{
+			message = fmt::format("cannot open {}: {}", name, std::strerror(errno));
+			return;
+		}
+		struct stat st;
+		if(::fstat(fd, &st) != 0 || (st.st_size != 0 && size_t(st.st_size) != size))
+		{
+			message = fmt::format("{} has the size of another migration setup", name);
+			::close(fd);
+			return;
+		}
+		// Every island resizes to the same size, so racing islands agree
+		if(st.st_size == 0 && ::ftruncate(fd, size) != 0)
+		{
+			message = fmt::format("cannot resize {}: {}", name, std::strerror(errno));
+			::close(fd);
+			return;
+		}
+		memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+	}
+	if(memory == MAP_FAILED)
+	{
+		message = fmt::format("cannot map {}: {}", name.empty() ? "mailbox" : name, std::strerror(errno));
+		return;
+	}
+	auto& shared = *static_cast<Shared*>(memory);
+	if(!claim(shared.islands, slots) || !claim(shared.migrants, capacity) || !claim(shared.stride, stride) || !claim(shared.run_seed, run_seed))
+	{
+		message = fmt::format("{} belongs to another run, remove /dev/shm{}", name, name);
+		::munmap(memory, size);
+		return;
+	}
+	shared.attached.fetch_add(1);
+	data = static_cast<std::byte*>(memory);
+	length = size;
+}
+
+Mailbox::~Mailbox()
+{
+	if(!data) return;
+	// A run that ends cleanly leaves nothing in /dev/shm for the next run with the same name
+	const bool last = reinterpret_cast<Shared*>(data)->attached.fetch_sub(1) == 1;
+	::munmap(data, length);
+	if(last && !name.empty())
+	{
+		::shm_unlink(name.c_str());
+	}
+}
+
+Mailbox::Slot& Mailbox::slot(const uint32_t island) const noexcept
+{
+	return *reinterpret_cast<Slot*>(data + align(sizeof(Shared)) + island * slot_size);
+}
+
+void Mailbox::send(const uint32_t island, const uint64_t generation, const Population& population, const uint32_t* rows, const std::vector<double>& fitnesses)
+{
+	assert(generation > 0 && population.genomes.cols() == stride);
+	auto& s = slot(island);
+	auto* scores = reinterpret_cast<double*>(&s + 1);
+	auto* genomes = reinterpret_cast<float*>(reinterpret_cast<std::byte*>(&s) + genomes_offset);
+	const uint64_t sequence = s.sequence.load(std::memory_order_relaxed);
+	s.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for(uint32_t m = 0; m < capacity; ++m)
+	{
+		scores[m] = fitnesses[rows[m]];
+		std::memcpy(genomes + size_t(m) * stride, population.genomes.row(rows[m]).data(), stride * sizeof(float));
+	}
+	s.generation.store(generation, std::memory_order_relaxed);
+	s.run_seed.store(run_seed, std::memory_order_relaxed);
+	s.layout.store(layout, std::memory_order_relaxed);
+	s.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+uint64_t Mailbox::receive(const uint32_t island, Population& population, const uint32_t first, double* fitnesses) const
+{
+	assert(population.genomes.cols() == stride && first + capacity <= population.size());
+	const auto& s = slot(island);
+	const auto* scores = reinterpret_cast<const double*>(&s + 1);
+	const auto* genomes = reinterpret_cast<const float*>(reinterpret_cast<const std::byte*>(&s) + genomes_offset);
+	for(uint32_t attempt = 0; attempt < max_attempts; ++attempt)
+	{
+		const uint64_t before = s.sequence.load(std::memory_order_acquire);
+		if(before == 0) return 0;
+		if(before & 1)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		const uint64_t generation = s.generation.load(std::memory_order_relaxed);
+		const bool ours = s.run_seed.load(std::memory_order_relaxed) == run_seed && s.layout.load(std::memory_order_relaxed) == layout;
+		std::memcpy(fitnesses, scores, capacity * sizeof(double));
+		std::memcpy(population.genomes.row(first).data(), genomes, size_t(capacity) * stride * sizeof(float));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		// A send that started while copying leaves a torn copy, read it again
+		if(s.sequence.load(std::memory_order_relaxed) == before) return ours ? generation : 0;
+	}
+	return 0;
+}
+
+Island::Island(Mailbox& mailbox, const uint32_t index, const Migration& migration, const Topology& topology) :
+	mailbox(mailbox),
+	index(index),
+	migration(migration),
+	arrivals(topology, migration.migrants * std::max(migration.islands - 1, 1u), false),
+	arrival_fitnesses(arrivals.size()),
+	arrival_order(arrivals.size()),
+	seen(migration.islands, 0)
+{
+}
+
+uint32_t Island::streams(const uint64_t generation) const noexcept
+{
+	return (index << 24) + static_cast<uint32_t>(generation);
+}
+
+void Island::migrate(const uint64_t generation, Population& population, std::vector<double>& fitnesses)
+{
+	if(migration.islands < 2 || !migration.interval || !generation || generation % migration.interval) return;
+	// Ties keep the lower row first, so the choice only depends on the fitnesses
+	order.resize(population.size());
+	std::iota(std::begin(order), std::end(order), 0);
+	std::sort(std::begin(order), std::end(order), [&](const uint32_t a, const uint32_t b)
+	{
+		return fitnesses[a] > fitnesses[b] || (fitnesses[a] == fitnesses[b] && a < b);
+	});
+	mailbox.send(index, generation, population, order.data(), fitnesses);
+
+	// Only migrants newer than those already taken from an island are kept
+	uint32_t count = 0;
+	const auto take = [&](const uint32_t source)
+	{
+		const auto sent = mailbox.receive(source, arrivals, count, arrival_fitnesses.data() + count);
+		if(sent > seen[source])
+		{
+			seen[source] = sent;
+			count += migration.migrants;
+		}
+	};
+	switch(migration.topology)
+	{
+	case MigrationTopology::RING:
+		take((index + migration.islands - 1) % migration.islands);
+		break;
+	case MigrationTopology::FULL:
+		for(uint32_t source = 0; source < migration.islands; ++source)
+		{
+			if(source != index) take(source);
+		}
+		break;
+	case MigrationTopology::RANDOM:
+	{
+		auto rng = random::stream(streams(generation), index, 0, random::Purpose::MIGRATION);
+		const auto draw = std::uniform_int_distribution<uint32_t>(0, migration.islands - 2)(rng);
+		take(draw < index ? draw : draw + 1);
+		break;
+	}
+	}
+
+	// The best arrivals replace the worst residents
+	const uint32_t imports = std::min(count, migration.migrants);
+	std::iota(std::begin(arrival_order), std::begin(arrival_order) + count, 0);
+	std::partial_sort(std::begin(arrival_order), std::begin(arrival_order) + imports, std::begin(arrival_order) + count, [&](const uint32_t a, const uint32_t b)
+	{
+		return arrival_fitnesses[a] > arrival_fitnesses[b] || (arrival_fitnesses[a] == arrival_fitnesses[b] && a < b);
+	});
+	for(uint32_t m = 0; m < imports; ++m)
+	{
+		const auto worst = order[order.size() - 1 - m];
+		population.genome(worst) = arrivals.genome(arrival_order[m]);
+		fitnesses[worst] = arrival_fitnesses[arrival_order[m]];
+	}
+	received += imports;
+}
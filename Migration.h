@@ -0,0 +1,98 @@
+#ifndef MIGRATION_H
+#define MIGRATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Population.h"
+
+// Which islands an island takes migrants from: its predecessor on a ring, all others, or
+// one other island drawn at every migration
+enum class MigrationTopology : uint32_t
+{
+	RING, FULL, RANDOM
+};
+
+// Island model settings. Every interval generations each island sends its migrants best
+// genomes and replaces its worst genomes with the newest migrants of its sources.
+struct Migration
+{
+	uint32_t islands = 1;
+	uint32_t interval = 10;
+	uint32_t migrants = 2;
+	MigrationTopology topology = MigrationTopology::RING;
+};
+
+// Shared memory with one slot per island. Only island i writes slot i, guarded by a
+// sequence lock: the sender never waits, receivers retry while a send is in progress.
+// With an empty name the memory is an anonymous mapping for islands running as threads,
+// otherwise a POSIX shared memory object that islands in separate processes open by name;
+// the last mailbox to close removes it.
+struct Mailbox
+{
+	Mailbox(const std::string& name, const Migration& migration, const uint32_t stride, const uint64_t run_seed);
+	Mailbox(const Mailbox&) = delete;
+	Mailbox& operator=(const Mailbox&) = delete;
+	~Mailbox();
+
+	// False when the memory could not be mapped or belongs to another run, see error()
+	bool valid() const noexcept { return data != nullptr; }
+	const std::string& error() const noexcept { return message; }
+	uint32_t islands() const noexcept { return slots; }
+	uint32_t migrants() const noexcept { return capacity; }
+	// Publishes rows rows[0, migrants) of population and their fitnesses as the migrants
+	// of island at generation, which has to be above 0
+	void send(const uint32_t island, const uint64_t generation, const Population& population, const uint32_t* rows, const std::vector<double>& fitnesses);
+	// Copies the newest migrants of island into rows [first, first + migrants) of population
+	// and fitnesses. Returns the generation they were sent at, 0 when there are none yet.
+	uint64_t receive(const uint32_t island, Population& population, const uint32_t first, double* fitnesses) const;
+
+private:
+	struct Slot;
+	Slot& slot(const uint32_t island) const noexcept;
+
+	std::string name;
+	std::byte* data = nullptr;
+	size_t length = 0;
+	size_t slot_size = 0;
+	size_t genomes_offset = 0;
+	uint32_t slots;
+	uint32_t capacity;
+	uint32_t stride;
+	uint64_t run_seed;
+	// Slot count, migrants and stride packed into the stamp of every send
+	uint64_t layout;
+	std::string message;
+};
+
+// One island of an island model run, exchanges genomes through a mailbox shared with the
+// other islands. Buffers are allocated once, migrations never wait for other islands.
+struct Island
+{
+	Island(Mailbox& mailbox, const uint32_t index, const Migration& migration, const Topology& topology);
+
+	// Random streams of island k start at generation k << 24, so islands never share
+	// random numbers and island 0 replays a run without islands
+	uint32_t streams(const uint64_t generation) const noexcept;
+	// Sends and receives migrants on every interval-th generation; fitnesses of population
+	// have to be evaluated
+	void migrate(const uint64_t generation, Population& population, std::vector<double>& fitnesses);
+	// Genomes taken from other islands so far
+	uint64_t immigrants() const noexcept { return received; }
+
+private:
+	Mailbox& mailbox;
+	uint32_t index;
+	Migration migration;
+	// Population rows by decreasing fitness
+	std::vector<uint32_t> order;
+	Population arrivals;
+	std::vector<double> arrival_fitnesses;
+	std::vector<uint32_t> arrival_order;
+	// Generation of the last migrants taken from every island
+	std::vector<uint64_t> seen;
+	uint64_t received = 0;
+};
+
+#endif // MIGRATION_H
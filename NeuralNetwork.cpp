@@ -23,6 +23,16 @@ uint32_t NeuralNetwork::layersCount() const noexcept
 	return weights.size() + 1;
 }
 
+uint32_t NeuralNetwork::inputsCount() const noexcept
+{
+	return weights.front().rows();
+}
+
+Eigen::Map<const Eigen::MatrixXf> NeuralNetwork::layer(const uint32_t l) const
+{
+	return Eigen::Map<const Eigen::MatrixXf>(weights[l].data(), weights[l].rows(), weights[l].cols());
+}
+
 Eigen::VectorXf NeuralNetwork::feedForward(const Eigen::VectorXf &input) const
 {
 	assert(input.rows() == weights.front().rows());
@@ -33,3 +43,78 @@ Eigen::VectorXf NeuralNetwork::feedForward(const Eigen::VectorXf &input) const
 	}
 	return res;
 }
+
+uint32_t NeuralNetwork::decide(const Eigen::VectorXf &input) const
+{
+	assert(input.rows() == weights.front().rows());
+	Eigen::RowVectorXf res = input;
+	for (uint32_t l = 0; l + 1 < weights.size(); ++l)
+	{
+		res = sigmoid(res * weights[l]);
+	}
+	Eigen::Index ind;
+	(res * weights.back()).maxCoeff(&ind);
+	return ind;
+}
+
+Topology::Topology(std::initializer_list<const uint32_t> sizes) : Topology(std::begin(sizes), std::end(sizes)) {}
+
+uint32_t Topology::layersCount() const noexcept
+{
+	return sizes.size();
+}
+
+uint32_t Topology::genomeLength() const noexcept
+{
+	return offsets.back();
+}
+
+uint32_t NeuralNetworkView::layersCount() const noexcept
+{
+	return topology->layersCount();
+}
+
+uint32_t NeuralNetworkView::inputsCount() const noexcept
+{
+	return topology->sizes.front();
+}
+
+Eigen::Map<const Eigen::MatrixXf> NeuralNetworkView::layer(const uint32_t l) const
+{
+	return Eigen::Map<const Eigen::MatrixXf>(weights + topology->offsets[l], topology->sizes[l], topology->sizes[l + 1]);
+}
+
+Eigen::VectorXf NeuralNetworkView::feedForward(const Eigen::VectorXf &input) const
+{
+	assert(input.rows() == inputsCount());
+	Eigen::RowVectorXf res = input;
+	for (uint32_t l = 0; l + 1 < layersCount(); ++l)
+	{
+		res = sigmoid(res * layer(l));
+	}
+	return res;
+}
+
+uint32_t NeuralNetworkView::decide(const Eigen::VectorXf &input) const
+{
+	assert(input.rows() == inputsCount());
+	Eigen::RowVectorXf res = input;
+	for (uint32_t l = 0; l + 2 < layersCount(); ++l)
+	{
+		res = sigmoid(res * layer(l));
+	}
+	Eigen::Index ind;
+	(res * layer(layersCount() - 2)).maxCoeff(&ind);
+	return ind;
+}
+
+NeuralNetworkView::operator NeuralNetwork() const
+{
+	NeuralNetwork res;
+	res.weights.reserve(layersCount() - 1);
+	for(uint32_t l = 0; l + 1 < layersCount(); ++l)
+	{
+		res.weights.emplace_back(layer(l));
+	}
+	return res;
+}
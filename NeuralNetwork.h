@@ -1,14 +1,27 @@
 #ifndef NEURAL_NETWORK_H
 #define NEURAL_NETWORK_H
 
+#include <array>
 #include <vector>
 #include <initializer_list>
 #include <iostream>
 #include <random>
 #include <eigen3/Eigen/Core>
 #include <fmt/core.h>
+#include <fmt/ostream.h>
+#include <fmt/ranges.h>
 #include "random.h"
 
+#if FMT_VERSION >= 90000
+// fmt 9 no longer formats through operator<< implicitly, Eigen expressions have to opt in.
+// Eigen 3.4 vectors are also ranges, which would make the formatter ambiguous.
+template<typename T>
+struct fmt::range_format_kind<T, char, std::enable_if_t<std::is_base_of_v<Eigen::DenseBase<T>, T>>> :
+	std::integral_constant<fmt::range_format, fmt::range_format::disabled> {};
+template<typename T>
+struct fmt::formatter<T, char, std::enable_if_t<std::is_base_of_v<Eigen::DenseBase<T>, T>>> : fmt::ostream_formatter {};
+#endif
+
 template<typename T>
 inline auto sigmoid(const T& x)
 {
@@ -61,8 +74,12 @@ inline auto softmax(const T& x)
 	}
 }
 
+// Topology chosen at runtime, every layer is a separate heap matrix
 struct NeuralNetwork
 {
+	using Input = Eigen::VectorXf;
+	using Output = Eigen::VectorXf;
+
 	std::vector<Eigen::MatrixXf> weights;
 
 	NeuralNetwork() = default;
@@ -71,9 +88,179 @@ struct NeuralNetwork
 	template<typename Distribution = std::uniform_real_distribution<double>>
 	NeuralNetwork(std::initializer_list<const uint32_t> sizes, Distribution& dis);
 	uint32_t layersCount() const noexcept;
+	uint32_t inputsCount() const noexcept;
+	Eigen::Map<const Eigen::MatrixXf> layer(const uint32_t l) const;
+	Eigen::VectorXf feedForward(const Eigen::VectorXf& input) const;
+	// Index of the largest output. The output activation is monotonic, so it is skipped.
+	uint32_t decide(const Eigen::VectorXf& input) const;
+};
+
+// Layer sizes of a network and where each weight layer starts in a flat genome. Genomes use
+// the same layout as FixedNeuralNetwork: each layer column major, one after another.
+struct Topology
+{
+	std::vector<uint32_t> sizes;
+	// offsets[l] - first weight of layer l, offsets.back() - genome length
+	std::vector<uint32_t> offsets;
+
+	Topology(std::initializer_list<const uint32_t> sizes);
+	template<typename Iterator>
+	Topology(Iterator first, Iterator last);
+
+	uint32_t layersCount() const noexcept;
+	uint32_t genomeLength() const noexcept;
+};
+
+// Non owning network over a flat genome, e.g. one row of a Population
+struct NeuralNetworkView
+{
+	using Input = Eigen::VectorXf;
+	using Output = Eigen::VectorXf;
+
+	const Topology* topology;
+	const float* weights;
+
+	uint32_t layersCount() const noexcept;
+	uint32_t inputsCount() const noexcept;
+	Eigen::Map<const Eigen::MatrixXf> layer(const uint32_t l) const;
 	Eigen::VectorXf feedForward(const Eigen::VectorXf& input) const;
+	uint32_t decide(const Eigen::VectorXf& input) const;
+	explicit operator NeuralNetwork() const;
 };
 
+template<typename Iterator>
+inline Topology::Topology(Iterator first, Iterator last) : sizes(first, last), offsets(1, 0)
+{
+	assert(sizes.size() >= 2);
+	offsets.reserve(sizes.size());
+	for(uint32_t l = 0; l + 1 < sizes.size(); ++l)
+	{
+		offsets.push_back(offsets.back() + sizes[l] * sizes[l + 1]);
+	}
+}
+
+// Topology fixed at compile time. All layers live in one fixed size genome (each layer
+// column major, one after another), so copies, forward passes and variation never
+// touch the heap and every loop has a compile time trip count.
+template<uint32_t... Sizes>
+struct FixedNeuralNetwork
+{
+	static_assert(sizeof...(Sizes) >= 2, "Network needs at least an input and an output layer");
+	static constexpr std::array<uint32_t, sizeof...(Sizes)> sizes{Sizes...};
+
+	// Index of the first weight of layer l inside the genome
+	static constexpr uint32_t offset(const uint32_t l)
+	{
+		uint32_t res = 0;
+		for(uint32_t i = 0; i < l; ++i) res += sizes[i] * sizes[i + 1];
+		return res;
+	}
+	static constexpr uint32_t genome_length = offset(sizeof...(Sizes) - 1);
+
+	using Genome = Eigen::Matrix<float, 1, genome_length>;
+	using Input = Eigen::Matrix<float, 1, sizes.front()>;
+	using Output = Eigen::Matrix<float, 1, sizes.back()>;
+	template<uint32_t L>
+	using Layer = Eigen::Matrix<float, sizes[L], sizes[L + 1]>;
+
+	Genome weights;
+
+	FixedNeuralNetwork(const bool randomize = true);
+	explicit FixedNeuralNetwork(const NeuralNetwork& nn);
+	explicit operator NeuralNetwork() const;
+
+	static constexpr uint32_t layersCount() noexcept { return sizeof...(Sizes); }
+	static constexpr uint32_t inputsCount() noexcept { return sizes.front(); }
+	template<uint32_t L>
+	Eigen::Map<const Layer<L>> layer() const { return Eigen::Map<const Layer<L>>(weights.data() + offset(L)); }
+	template<uint32_t L>
+	Eigen::Map<Layer<L>> layer() { return Eigen::Map<Layer<L>>(weights.data() + offset(L)); }
+	Eigen::Map<const Eigen::MatrixXf> layer(const uint32_t l) const;
+	Output feedForward(const Input& input) const;
+	uint32_t decide(const Input& input) const;
+
+private:
+	// With Activate false the last layer stays linear
+	template<uint32_t L, bool Activate, typename Row>
+	Output forward(const Row& x) const;
+};
+
+template<uint32_t... Sizes>
+inline FixedNeuralNetwork<Sizes...>::FixedNeuralNetwork(const bool randomize)
+{
+	if (!randomize)
+	{
+		weights.setZero();
+	}
+	else
+	{
+		std::uniform_real_distribution dis(-1.0, 1.0);
+		weights = Genome::NullaryExpr([&](){return dis(random::random_generator);});
+	}
+}
+
+template<uint32_t... Sizes>
+inline FixedNeuralNetwork<Sizes...>::FixedNeuralNetwork(const NeuralNetwork& nn)
+{
+	assert(nn.layersCount() == layersCount());
+	for(uint32_t l = 0; l + 1 < layersCount(); ++l)
+	{
+		assert(nn.weights[l].rows() == sizes[l] && nn.weights[l].cols() == sizes[l + 1]);
+		std::copy_n(nn.weights[l].data(), nn.weights[l].size(), weights.data() + offset(l));
+	}
+}
+
+template<uint32_t... Sizes>
+inline FixedNeuralNetwork<Sizes...>::operator NeuralNetwork() const
+{
+	NeuralNetwork res;
+	res.weights.reserve(layersCount() - 1);
+	for(uint32_t l = 0; l + 1 < layersCount(); ++l)
+	{
+		res.weights.emplace_back(layer(l));
+	}
+	return res;
+}
+
+template<uint32_t... Sizes>
+inline Eigen::Map<const Eigen::MatrixXf> FixedNeuralNetwork<Sizes...>::layer(const uint32_t l) const
+{
+	return Eigen::Map<const Eigen::MatrixXf>(weights.data() + offset(l), sizes[l], sizes[l + 1]);
+}
+
+template<uint32_t... Sizes>
+inline typename FixedNeuralNetwork<Sizes...>::Output FixedNeuralNetwork<Sizes...>::feedForward(const Input& input) const
+{
+	return forward<0, true>(input);
+}
+
+template<uint32_t... Sizes>
+inline uint32_t FixedNeuralNetwork<Sizes...>::decide(const Input& input) const
+{
+	Eigen::Index ind;
+	forward<0, false>(input).maxCoeff(&ind);
+	return ind;
+}
+
+template<uint32_t... Sizes>
+template<uint32_t L, bool Activate, typename Row>
+inline typename FixedNeuralNetwork<Sizes...>::Output FixedNeuralNetwork<Sizes...>::forward(const Row& x) const
+{
+	if constexpr(L + 2 < layersCount())
+	{
+		const Eigen::Matrix<float, 1, sizes[L + 1]> res = sigmoid(x * layer<L>()).matrix();
+		return forward<L + 1, Activate>(res);
+	}
+	else if constexpr(Activate)
+	{
+		return sigmoid(x * layer<L>()).matrix();
+	}
+	else
+	{
+		return x * layer<L>();
+	}
+}
+
 template<typename Distribution>
 inline NeuralNetwork::NeuralNetwork(std::initializer_list<const uint32_t> sizes, Distribution& dis)
 {
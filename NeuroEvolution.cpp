@@ -1,4 +1,133 @@
 #include "NeuroEvolution.h"
+#include <limits>
+#include <numeric>
+#include <mutex>
+#include "AllocationCounter.h"
+#include "Checkpoint.h"
+#include "IndexedMinHeap.h"
+#include "NoiseTable.h"
+#include "Telemetry.h"
+#include "Trace.h"
+
+namespace
+{
+	// Children bred per round of the steady state engine. It does not depend on the thread
+	// count, so a run gives the same result on any machine.
+	constexpr uint32_t steady_round = 32;
+	// Samples of the evolution strategies noise table, 4 MB shared by all generations and
+	// thousands of times the length of a genome
+	constexpr size_t noise_table_size = size_t(1) << 20;
+
+	// Loads the checkpoint at checkpointing.path into population and fitnesses when asked to
+	// resume and one exists. An incompatible checkpoint ends the program instead of being
+	// overwritten by a fresh run. random::run_seed has to be the checkpoint's already: island
+	// threads resume concurrently and read it, so the caller sets it before they start.
+	bool resume(const Checkpointing& checkpointing, const checkpoint::Engine engine, Population& population, std::vector<double>& fitnesses, uint64_t& generation)
+	{
+		if(!checkpointing.resume) return false;
+		const checkpoint::Mapped file(checkpointing.path);
+		if(!file.exists()) return false;
+		if(!file.valid() || file.header().engine != engine || !file.matches(population) || file.header().run_seed != random::run_seed)
+		{
+			fmt::print(stderr, "Cannot resume: {}\n", file.valid() ? "checkpoint of another engine, population or seed" : file.error());
+			std::exit(1);
+		}
+		file.restore(population, fitnesses);
+		generation = file.header().generation;
+		fmt::print("Resumed {} at generation {}\n", checkpointing.path, generation);
+		return true;
+	}
+
+	void write(trace::Writer& traces, const trace::Trace& trace)
+	{
+		if(!traces.write(trace))
+		{
+			fmt::print(stderr, "Cannot write traces {}\n", traces.path());
+		}
+	}
+
+	void save(const Checkpointing& checkpointing, const checkpoint::Engine engine, const uint64_t generation, const Population& population, const std::vector<double>& fitnesses)
+	{
+		if(!checkpoint::save(checkpointing.path, engine, generation, population, fitnesses))
+		{
+			fmt::print(stderr, "Cannot write checkpoint {}\n", checkpointing.path);
+		}
+	}
+
+	// Progress line with the heap allocations and simulated steps of the last generation
+	void report(const double best, const uint64_t allocated, const uint64_t steps)
+	{
+		if(!NeuroEvolution::verbose) return;
+		if(!allocations::supported())
+		{
+			fmt::print("Best score: {}\n", best);
+			return;
+		}
+		fmt::print("Best score: {}, allocations: {} ({:.4f} per step)\n",
+			best, allocated, static_cast<double>(allocated) / std::max<uint64_t>(steps, 1));
+	}
+
+	// Replays the episode the best of population played on the streams of generation, so
+	// the trace shows the score its fitness came from
+	template<typename Networks>
+	void traceBest(trace::Writer& traces, const SnakeData& problem, const uint32_t sim_time, const Networks& population, const std::vector<double>& fitnesses, const uint32_t generation)
+	{
+		const uint32_t best = std::max_element(std::begin(fitnesses), std::end(fitnesses)) - std::begin(fitnesses);
+		write(traces, trace::record(problem, population[best], sim_time, generation, best));
+	}
+
+	// Counters of one generation, taken at construction. Engines add phase times to record
+	// as they go and summarise the fitnesses while they are valid, finish() completes the
+	// record for the telemetry stream and the progress line.
+	struct Generation
+	{
+		const Evaluator& evaluator;
+		const allocations::Scope allocated;
+		const uint64_t steps = evaluator.steps();
+		const uint64_t episodes = evaluator.episodes();
+		const uint64_t timeouts = evaluator.timeouts();
+		Telemetry::Stopwatch wall;
+		Telemetry::Stopwatch phase;
+		Telemetry::Record record;
+
+		explicit Generation(const Evaluator& evaluator) : evaluator(evaluator) {}
+
+		void summarise(Telemetry* telemetry, const std::vector<double>& fitnesses)
+		{
+			if(telemetry)
+			{
+				telemetry->summarise(fitnesses, record);
+			}
+			else
+			{
+				record.best = *std::max_element(std::begin(fitnesses), std::end(fitnesses));
+			}
+		}
+
+		void finish(Telemetry* telemetry, const uint64_t generation, const bool print)
+		{
+			record.generation = generation;
+			record.steps = evaluator.steps() - steps;
+			record.episodes = evaluator.episodes() - episodes;
+			record.timeouts = evaluator.timeouts() - timeouts;
+			record.wall = wall.lap();
+			record.allocations = allocated.count();
+			if(telemetry)
+			{
+				telemetry->push(record);
+			}
+			if(print)
+			{
+				report(record.best, record.allocations, record.steps);
+			}
+		}
+	};
+}
+
+Topology NeuroEvolution::topology(const SnakeData& problem)
+{
+	return Topology({problem.inputs(), Policy::sizes.back()});
+}
 
 uint32_t NeuroEvolution::tournament(const std::vector<double>& fitnesses, const uint32_t t_size) noexcept
 {
@@ -18,186 +147,457 @@ uint32_t NeuroEvolution::tournament(const std::vector<double>& fitnesses, const
 	return best;
 }
 
+void NeuroEvolution::mutate(Population::Genome genome)
+{
+	random::vector_generator.addUniform(genome.data(), genome.size(), -0.4f, 0.4f);
+}
+
+void NeuroEvolution::cross(const Population::ConstGenome& genome1, const Population::ConstGenome& genome2, Population::Genome res)
+{
+	assert(genome1.size() == genome2.size() && genome1.size() == res.size());
+	// Select weight from genome1 or genome2
+	random::vector_generator.blend(genome1.data(), genome2.data(), res.data(), res.size());
+}
+
 void NeuroEvolution::mutate(NeuralNetwork& nn)
 {
-	static std::uniform_real_distribution dis(-0.4f, 0.4f);
 	for(auto& m : nn.weights)
 	{
-		for(uint32_t i = 0; i < m.size(); ++i)
-		{
-			m.data()[i] += dis(random::random_generator);
-		}
+		random::vector_generator.addUniform(m.data(), m.size(), -0.4f, 0.4f);
 	}
 }
 
 NeuralNetwork NeuroEvolution::cross(const NeuralNetwork& nn1, const NeuralNetwork& nn2)
 {
 	assert(nn1.weights.size() == nn2.weights.size());
-	std::bernoulli_distribution dis;
 	NeuralNetwork res(nn1);
 	for(uint32_t i = 0; i < res.weights.size(); ++i)
 	{
-		const auto size = res.weights[i].size();
-		for(uint32_t j = 0; j < size; ++j)
-		{
-			// Select weight from nn1 or nn2
-			res.weights[i](j) = dis(random::random_generator) ? nn1.weights[i](j) : nn2.weights[i](j);
-			//res.weights[i](j) = (nn1.weights[i](j) + nn2.weights[i](j)) / 2;
-		}
+		// Select weight from nn1 or nn2
+		random::vector_generator.blend(nn1.weights[i].data(), nn2.weights[i].data(), res.weights[i].data(), res.weights[i].size());
+		//res.weights[i](j) = (nn1.weights[i](j) + nn2.weights[i](j)) / 2;
 	}
 	return res;
 }
 
-NeuralNetwork NeuroEvolution::neuro_evolution(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time)
+NeuralNetwork NeuroEvolution::neuro_evolution(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time, const uint32_t threads, const Racing racing, const Caching caching, const Checkpointing& checkpointing, Telemetry* telemetry, trace::Writer* traces, Island* island)
 {
 	std::uniform_real_distribution<double> prob(0.0, 1.0);
-	std::uniform_int_distribution<uint32_t> pos(1, problem.data.rows()-2);
+	Evaluator evaluator(problem, sim_time, threads, racing, caching);
+	const Topology topology = NeuroEvolution::topology(problem);
+	// Generation i uses the streams of generation streams(i)
+	const auto streams = [island](const uint64_t i){ return island ? island->streams(i) : static_cast<uint32_t>(i); };
 	// Vector fitnessów - im mniej tym lepiej
-	std::vector<NeuralNetwork> population;
-	population.reserve(pop_size);
-	for(uint32_t i = 0; i < pop_size; ++i)
-	{
-		population.push_back({10, 3});
-	}
-	std::vector<NeuralNetwork> new_population(pop_size);
+	random::use(streams(0), 0, 0, random::Purpose::INITIALIZATION);
+	Population population(topology, pop_size);
+	Population new_population(topology, pop_size, false);
 	std::vector<double> fitnesses(pop_size);
-	for(uint64_t i = 0; i < iterations; ++i)
+	// A checkpoint holds an evaluated population, so the first generation after resuming
+	// goes straight to breeding
+	uint64_t first = 0;
+	const bool resumed = resume(checkpointing, checkpoint::Engine::GENERATIONAL, population, fitnesses, first);
+	for(uint64_t i = first; i < iterations; ++i)
 	{
+		Generation progress(evaluator);
 		// Obliczenie fitnessów
-		for(uint32_t iter = 0; iter < pop_size; ++iter)
+		if(!resumed || i != first)
 		{
-			SnakeNN snake(pos(random::random_generator), pos(random::random_generator), population[iter]);
-			uint32_t step = 0;
-			for(; step < sim_time && problem.step(snake); ++step);
-			fitnesses[iter] = snake.score;
+			evaluator.generation = streams(i);
+			evaluator.evaluate(population, fitnesses);
+			progress.record.evaluation = progress.phase.lap();
+			if(checkpointing.interval && !(i % checkpointing.interval))
+			{
+				save(checkpointing, checkpoint::Engine::GENERATIONAL, i, population, fitnesses);
+			}
+			if(traces && traces->due(i))
+			{
+				traceBest(*traces, problem, sim_time, population, fitnesses, streams(i));
+			}
+		}
+		if(island)
+		{
+			island->migrate(i, population, fitnesses);
 		}
-		// Ewolucja właściwa
+		progress.summarise(telemetry, fitnesses);
+		progress.phase.lap();
+		// Ewolucja właściwa, dzieci powstają od razu w nowej populacji
 		for(uint32_t iter = 0; iter < pop_size; ++iter)
 		{
+			random::use(streams(i), iter, 0, random::Purpose::VARIATION);
 			// Selekcja
 			const auto selected_indx1 = NeuroEvolution::tournament(fitnesses, t_size);
 			const auto selected_indx2 = NeuroEvolution::tournament(fitnesses, t_size);
+			progress.record.selection += progress.phase.lap();
 			// Crossover
-			NeuralNetwork new_nn = population[selected_indx1];
+			auto new_nn = new_population.genome(iter);
 			if(prob(random::random_generator) < prob_cross)
 			{
-				new_nn = NeuroEvolution::cross(population[selected_indx1], population[selected_indx2]);
+				NeuroEvolution::cross(population.genome(selected_indx1), population.genome(selected_indx2), new_nn);
+			}
+			else
+			{
+				new_nn = population.genome(selected_indx1);
 			}
+			progress.record.crossover += progress.phase.lap();
 			// Mutacja s1
 			if(prob(random::random_generator) < prob_mut)
 			{
 				NeuroEvolution::mutate(new_nn);
 			}
-			// Dodaj do nowej populacji
-			new_population[iter] = std::move(new_nn);
+			progress.record.mutation += progress.phase.lap();
 		}
 		// Zamień populacje
-		std::swap(population, new_population);
-		if(!(i%100)){
-			fmt::print("Best score: {}\n", *std::max_element(std::begin(fitnesses), std::end(fitnesses)));
-		}
+		population.swap(new_population);
+		progress.finish(telemetry, i, !(i%100));
 	}
 	//fmt::print("\n{}\n", fitnesses);
 	const auto index = std::max_element(std::begin(fitnesses), std::end(fitnesses));
-	fmt::print("Selected Fitness: {}\n", *index);
-	return population[index - std::begin(fitnesses)];
+	if(verbose) fmt::print("Selected Fitness: {}\n", *index);
+	return population.network(index - std::begin(fitnesses));
 }
 
-NeuralNetwork NeuroEvolution::neuro_evolution_steady(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time)
+NeuralNetwork NeuroEvolution::neuro_evolution_steady(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time, const uint32_t threads, const Racing racing, const Caching caching, const Checkpointing& checkpointing, Telemetry* telemetry, trace::Writer* traces)
 {
 	std::uniform_real_distribution<double> prob(0.0, 1.0);
-	std::uniform_int_distribution<uint32_t> pos(1, problem.data.rows()-2);
+	Evaluator evaluator(problem, sim_time, threads, racing, caching);
+	const Topology topology = NeuroEvolution::topology(problem);
 	// Vector fitnessów - im mniej tym lepiej
-	std::vector<NeuralNetwork> population;
-	population.reserve(pop_size);
-	for(uint32_t i = 0; i < pop_size; ++i)
+	random::use(0, 0, 0, random::Purpose::INITIALIZATION);
+	Population population(topology, pop_size);
+	std::vector<double> fitnesses(pop_size);
+	// Rounds completed, the initial evaluation is round 0
+	uint64_t first = 0;
+	if(!resume(checkpointing, checkpoint::Engine::STEADY, population, fitnesses, first))
+	{
+		evaluator.evaluate(population, fitnesses);
+	}
+	// Worst genome on top, replaced in O(log n)
+	IndexedMinHeap<double> ranking(fitnesses);
+	// Each round breeds a batch of children, so all cores simulate in parallel
+	Population children(topology, steady_round, false);
+	std::vector<double> children_fitnesses;
+	for(uint64_t i = first * steady_round; i < iterations; i += children.size())
 	{
-		population.push_back({10, 3});
+		Generation progress(evaluator);
+		const uint32_t round = i / steady_round + 1;
+		if(iterations - i < children.size())
+		{
+			children.resize(iterations - i);
+		}
+		for(uint32_t c = 0; c < children.size(); ++c)
+		{
+			random::use(round, c, 0, random::Purpose::VARIATION);
+			auto new_nn = children.genome(c);
+			// Selekcja
+			const auto selected_indx1 = NeuroEvolution::tournament(ranking.keys(), t_size);
+			const auto selected_indx2 = NeuroEvolution::tournament(ranking.keys(), t_size);
+			progress.record.selection += progress.phase.lap();
+			// Crossover
+			if(prob(random::random_generator) < prob_cross)
+			{
+				NeuroEvolution::cross(population.genome(selected_indx1), population.genome(selected_indx2), new_nn);
+			}
+			else
+			{
+				new_nn = population.genome(selected_indx1);
+			}
+			progress.record.crossover += progress.phase.lap();
+			if(prob(random::random_generator) < prob_mut)
+			{
+				NeuroEvolution::mutate(new_nn);
+			}
+			progress.record.mutation += progress.phase.lap();
+		}
+		evaluator.generation = round;
+		evaluator.evaluate(children, children_fitnesses);
+		progress.record.evaluation = progress.phase.lap();
+		if(traces && traces->due(round))
+		{
+			traceBest(*traces, problem, sim_time, children, children_fitnesses, round);
+		}
+
+		for(uint32_t c = 0; c < children.size(); ++c)
+		{
+			const auto worst = ranking.top();
+			ranking.update(worst, children_fitnesses[c]);
+			population.genome(worst) = children.genome(c);
+		}
+		if(checkpointing.interval && !(round % checkpointing.interval))
+		{
+			save(checkpointing, checkpoint::Engine::STEADY, round, population, ranking.keys());
+		}
+		progress.summarise(telemetry, ranking.keys());
+		progress.finish(telemetry, round, i % 4000 < children.size());
 	}
+	//fmt::print("\n{}\n", fitnesses);
+	const auto& scores = ranking.keys();
+	const auto index = std::max_element(std::begin(scores), std::end(scores));
+	if(verbose) fmt::print("Selected Fitness: {}\n", *index);
+	return population.network(index - std::begin(scores));
+}
+
+NeuralNetwork NeuroEvolution::neuro_evolution_async(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time, const uint32_t threads, const Checkpointing& checkpointing, Telemetry* telemetry, trace::Writer* traces)
+{
+	std::uniform_real_distribution<double> prob(0.0, 1.0);
+	Evaluator evaluator(problem, sim_time, threads);
+	const Topology topology = NeuroEvolution::topology(problem);
+	random::use(0, 0, 0, random::Purpose::INITIALIZATION);
+	Population population(topology, pop_size);
 	std::vector<double> fitnesses(pop_size);
-	for(uint32_t iter = 0; iter < pop_size; ++iter)
+	// Children inserted so far
+	uint64_t first = 0;
+	if(!resume(checkpointing, checkpoint::Engine::ASYNC, population, fitnesses, first))
+	{
+		evaluator.evaluate(population, fitnesses);
+	}
+	IndexedMinHeap<double> ranking(fitnesses);
+	uint64_t inserted = first;
+	// Child currently bred and played by each worker. Each is genome 0 of its own population,
+	// so child i plays on the streams of generation i + 1 whichever worker picks it up
+	std::vector<Population> children;
+	children.reserve(evaluator.threads());
+	for(uint32_t w = 0; w < evaluator.threads(); ++w)
 	{
-		SnakeNN snake(pos(random::random_generator), pos(random::random_generator), population[iter]);
-		uint32_t step = 0;
-		for(; step < sim_time && problem.step(snake); ++step);
-		fitnesses[iter] = snake.score;
+		children.emplace_back(topology, 1, false);
 	}
-	for(uint64_t i = 0; i < iterations; ++i)
+	std::vector<std::vector<double>> children_fitnesses(evaluator.threads(), std::vector<double>(1));
+	// Guards population, ranking and the progress counters, episodes are played outside of it
+	std::mutex mutex;
+	allocations::Scope progress_allocations;
+	uint64_t progress_steps = 0;
+	// Telemetry of the current steady_round children, filled as they are inserted
+	Telemetry::Record pending;
+	// Best child of the current steady_round children and the generation of its streams
+	Population best_child(topology, 1, false);
+	double best_fitness = -std::numeric_limits<double>::infinity();
+	uint32_t best_generation = 0;
+	Telemetry::Stopwatch pending_wall;
+	// Every child is a pool task, a worker picks the next one as soon as it inserted its
+	// previous child, so there is no barrier between children
+	evaluator.pool.parallel_for(iterations - std::min<uint64_t>(first, iterations), [&](const uint32_t task, const uint32_t worker)
 	{
-		// Selekcja
-		const auto selected_indx1 = NeuroEvolution::tournament(fitnesses, t_size);
-		const auto selected_indx2 = NeuroEvolution::tournament(fitnesses, t_size);
-		// Crossover
-		NeuralNetwork new_nn = NeuroEvolution::cross(population[selected_indx1], population[selected_indx2]);
+		const uint32_t i = first + task;
+		auto new_nn = children[worker].genome(0);
+		const double& fitness = children_fitnesses[worker].front();
+		Telemetry::Stopwatch phase;
+		Telemetry::Record child;
+		{
+			std::lock_guard lock(mutex);
+			phase.lap();
+			random::use(i + 1, 0, 0, random::Purpose::VARIATION);
+			// Selekcja
+			const auto selected_indx1 = NeuroEvolution::tournament(ranking.keys(), t_size);
+			const auto selected_indx2 = NeuroEvolution::tournament(ranking.keys(), t_size);
+			child.selection = phase.lap();
+			// Crossover
+			if(prob(random::random_generator) < prob_cross)
+			{
+				NeuroEvolution::cross(population.genome(selected_indx1), population.genome(selected_indx2), new_nn);
+			}
+			else
+			{
+				new_nn = population.genome(selected_indx1);
+			}
+			child.crossover = phase.lap();
+		}
 		if(prob(random::random_generator) < prob_mut)
 		{
 			NeuroEvolution::mutate(new_nn);
 		}
+		child.mutation = phase.lap();
+		auto& batch = evaluator.batches[worker];
+		const auto steps = batch.steps;
+		const auto timeouts = batch.timeouts;
+		batch.evaluate(children[worker], 0u, 1u, children_fitnesses[worker], i + 1);
+		child.evaluation = phase.lap();
 
-		const auto index = std::min_element(std::begin(fitnesses), std::end(fitnesses));
-
-		SnakeNN snake(pos(random::random_generator), pos(random::random_generator), new_nn);
-		uint32_t step = 0;
-		for(; step < sim_time && problem.step(snake); ++step);
-		*index = snake.score;
-
-		population[index - std::begin(fitnesses)] = std::move(new_nn);
-
-		if(!(i%4000)){
-			fmt::print("Best score: {}\n", *std::max_element(std::begin(fitnesses), std::end(fitnesses)));
+		std::lock_guard lock(mutex);
+		const auto worst = ranking.top();
+		ranking.update(worst, fitness);
+		population.genome(worst) = new_nn;
+		progress_steps += batch.steps - steps;
+		pending.selection += child.selection;
+		pending.crossover += child.crossover;
+		pending.mutation += child.mutation;
+		pending.evaluation += child.evaluation;
+		pending.steps += batch.steps - steps;
+		pending.timeouts += batch.timeouts - timeouts;
+		++pending.episodes;
+		++inserted;
+		if(traces && fitness > best_fitness)
+		{
+			best_child.genome(0) = new_nn;
+			best_fitness = fitness;
+			best_generation = i + 1;
 		}
-	}
-	//fmt::print("\n{}\n", fitnesses);
-	const auto index = std::max_element(std::begin(fitnesses), std::end(fitnesses));
-	fmt::print("Selected Fitness: {}\n", *index);
-	return population[index - std::begin(fitnesses)];
+		if(traces && !(inserted % steady_round))
+		{
+			if(traces->due(inserted / steady_round))
+			{
+				write(*traces, trace::record(problem, best_child[0], sim_time, best_generation, 0));
+			}
+			best_fitness = -std::numeric_limits<double>::infinity();
+		}
+		if(checkpointing.interval && !(inserted % checkpointing.interval))
+		{
+			save(checkpointing, checkpoint::Engine::ASYNC, inserted, population, ranking.keys());
+		}
+		if(telemetry && !(inserted % steady_round))
+		{
+			pending.generation = inserted / steady_round;
+			pending.wall = pending_wall.lap();
+			telemetry->summarise(ranking.keys(), pending);
+			telemetry->push(pending);
+			pending = {};
+		}
+		if(!(i % 4000)){
+			const auto& scores = ranking.keys();
+			report(*std::max_element(std::begin(scores), std::end(scores)), progress_allocations.count(), progress_steps);
+			progress_allocations = {};
+			progress_steps = 0;
+		}
+	});
+	const auto& scores = ranking.keys();
+	const auto index = std::max_element(std::begin(scores), std::end(scores));
+	if(verbose) fmt::print("Selected Fitness: {}\n", *index);
+	return population.network(index - std::begin(scores));
 }
 
-NeuralNetwork NeuroEvolution::cross_entropy(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const uint32_t elite_size, const double learn_rate, const uint32_t sim_time)
+NeuralNetwork NeuroEvolution::cross_entropy(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const uint32_t elite_size, const double learn_rate, const uint32_t sim_time, const uint32_t threads, const Racing racing, const Caching caching, const Checkpointing& checkpointing, Telemetry* telemetry, trace::Writer* traces)
 {
-	std::uniform_int_distribution<uint32_t> pos(1, problem.data.rows()-2);
-	NeuralNetwork global_nn({10, 3});
-	std::vector<NeuralNetwork> population;
+	Evaluator evaluator(problem, sim_time, threads, racing, caching);
+	const Topology topology = NeuroEvolution::topology(problem);
+	random::use(0, 0, 0, random::Purpose::INITIALIZATION);
+	// The distribution is the whole state: checkpoints hold its center global_nn and the
+	// best sample of the last generation
+	Population center(topology, 1);
+	auto global_nn = center.genome(0);
+	Population population(topology, pop_size, false);
 	std::vector<double> fitnesses;
-	//std::vector<uint32_t> elite_indices;
-	population.reserve(pop_size);
 	fitnesses.reserve(pop_size);
-	//elite_indices.reserve(elite_size);
-	for(uint64_t i = 0; i < iterations; ++i)
+	const uint32_t elite = std::min(elite_size, pop_size);
+	std::vector<uint32_t> order(pop_size);
+	Eigen::RowVectorXf mean(topology.genomeLength());
+	std::vector<double> center_fitness(1);
+	uint64_t first = 0;
+	resume(checkpointing, checkpoint::Engine::CROSS_ENTROPY, center, center_fitness, first);
+	for(uint64_t i = first; i < iterations; ++i)
 	{
+		Generation progress(evaluator);
 		// Generowanie sąsiadów
 		for(uint32_t j = 0; j < pop_size; ++j)
 		{
-			auto& elem = population.emplace_back(global_nn);
+			random::use(i, j, 0, random::Purpose::VARIATION);
+			auto elem = population.genome(j);
+			elem = global_nn;
 			NeuroEvolution::mutate(elem);
-			
-			SnakeNN snake(pos(random::random_generator), pos(random::random_generator), elem);
-			uint32_t step = 0;
-			for(; step < sim_time && problem.step(snake); ++step);
-			fitnesses.emplace_back(snake.score);
 		}
-		// Stworzenie elity
-		for(uint32_t j = 0; j < elite_size; ++j)
+		progress.record.mutation = progress.phase.lap();
+		evaluator.generation = i;
+		evaluator.evaluate(population, fitnesses);
+		progress.record.evaluation = progress.phase.lap();
+		progress.summarise(telemetry, fitnesses);
+		center_fitness.front() = progress.record.best;
+		if(traces && traces->due(i))
+		{
+			traceBest(*traces, problem, sim_time, population, fitnesses, i);
+		}
+		// Stworzenie elity: the center moves learn_rate of the way to the mean of the elite
+		std::iota(std::begin(order), std::end(order), 0);
+		std::partial_sort(std::begin(order), std::begin(order) + elite, std::end(order), [&](const uint32_t a, const uint32_t b)
+		{
+			return fitnesses[a] > fitnesses[b] || (fitnesses[a] == fitnesses[b] && a < b);
+		});
+		mean.setZero();
+		for(uint32_t j = 0; j < elite; ++j)
 		{
-			const auto ptr = std::max_element(std::begin(fitnesses), std::end(fitnesses));
-			const auto index = ptr - std::begin(fitnesses);
+			mean += population.genome(order[j]);
+		}
+		global_nn += static_cast<float>(learn_rate) * (mean / static_cast<float>(elite) - global_nn);
+		progress.record.selection = progress.phase.lap();
 
-			for(uint32_t k = 0; k < global_nn.weights.size(); ++k)
-			{
-				//global_nn.weights[k] += learn_rate * (population[index].weights[k] / elite_size);
-				global_nn.weights[k] = (population[index].weights[k] / elite_size);
-			}
+		if(checkpointing.interval && !((i + 1) % checkpointing.interval))
+		{
+			save(checkpointing, checkpoint::Engine::CROSS_ENTROPY, i + 1, center, center_fitness);
+		}
+		progress.finish(telemetry, i, !(i%100));
+		fitnesses.clear();
+	}
+	return center.network(0);
+}
+
+NeuralNetwork NeuroEvolution::evolution_strategies(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float sigma, const double learn_rate, const uint32_t sim_time, const uint32_t threads, const Racing racing, const Caching caching, const Checkpointing& checkpointing, Telemetry* telemetry, trace::Writer* traces)
+{
+	Evaluator evaluator(problem, sim_time, threads, racing, caching);
+	const Topology topology = NeuroEvolution::topology(problem);
+	random::use(0, 0, 0, random::Purpose::INITIALIZATION);
+	// As in cross_entropy the center is the whole state
+	Population center(topology, 1);
+	auto theta = center.genome(0);
+	std::vector<double> center_fitness(1);
+	uint64_t first = 0;
+	resume(checkpointing, checkpoint::Engine::EVOLUTION_STRATEGIES, center, center_fitness, first);
+	// Drawn from the run seed, which train takes from the checkpoint of a resumed run
+	const NoiseTable table(noise_table_size, random::stream(0, 0, 0, random::Purpose::NOISE));
+
+	// Genome p is theta + sigma * noise row p and genome p + pairs its mirror theta - sigma *
+	// noise row p; row padding stays 0
+	assert(pop_size >= 2 && pop_size % 2 == 0);
+	const uint32_t pairs = pop_size / 2;
+	const uint32_t length = topology.genomeLength();
+	Population population(topology, 2 * pairs, false);
+	Population::Genomes noise(pairs, length);
+	std::vector<double> fitnesses;
+	fitnesses.reserve(2 * pairs);
+	std::vector<uint32_t> order(2 * pairs);
+	std::vector<float> utilities(2 * pairs);
+	Eigen::VectorXf weights(pairs);
+	for(uint64_t i = first; i < iterations; ++i)
+	{
+		Generation progress(evaluator);
+		auto rng = random::stream(i, 0, 0, random::Purpose::VARIATION);
+		for(uint32_t p = 0; p < pairs; ++p)
+		{
+			noise.row(p) = table.window(table.offset(rng, length), length);
+		}
+		population.genomes.topLeftCorner(pairs, length) = (sigma * noise).rowwise() + theta;
+		population.genomes.bottomLeftCorner(pairs, length) = (-sigma * noise).rowwise() + theta;
+		progress.record.mutation = progress.phase.lap();
+		evaluator.generation = i;
+		evaluator.evaluate(population, fitnesses);
+		progress.record.evaluation = progress.phase.lap();
+		progress.summarise(telemetry, fitnesses);
+		center_fitness.front() = progress.record.best;
+		if(traces && traces->due(i))
+		{
+			traceBest(*traces, problem, sim_time, population, fitnesses, i);
+		}
 
-			//elite_indices.emplace_back(ptr - std::begin(fitnesses));
-			*ptr = -1000;
+		// Centered ranks in [-0.5, 0.5] make the step independent of the score scale and of
+		// outliers; a pair weighs its noise row by how much better its + side ranked
+		std::iota(std::begin(order), std::end(order), 0);
+		std::sort(std::begin(order), std::end(order), [&](const uint32_t a, const uint32_t b)
+		{
+			return fitnesses[a] < fitnesses[b] || (fitnesses[a] == fitnesses[b] && a < b);
+		});
+		for(uint32_t r = 0; r < order.size(); ++r)
+		{
+			utilities[order[r]] = order.size() > 1 ? static_cast<float>(r) / (order.size() - 1) - 0.5f : 0.0f;
+		}
+		for(uint32_t p = 0; p < pairs; ++p)
+		{
+			weights[p] = utilities[p] - utilities[p + pairs];
 		}
+		// Gradient estimate of the smoothed fitness, one product over the noise matrix
+		theta.noalias() += static_cast<float>(learn_rate / (2.0 * pairs * sigma)) * (weights.transpose() * noise);
+		progress.record.selection = progress.phase.lap();
 
-		//elite_indices.clear();
-		if(!(i%100)){
-			fmt::print("Best score: {}\n", *std::max_element(std::begin(fitnesses), std::end(fitnesses)));
+		if(checkpointing.interval && !((i + 1) % checkpointing.interval))
+		{
+			save(checkpointing, checkpoint::Engine::EVOLUTION_STRATEGIES, i + 1, center, center_fitness);
 		}
-		population.clear();
+		progress.finish(telemetry, i, !(i%100));
 		fitnesses.clear();
 	}
-	return global_nn;
+	return center.network(0);
 }
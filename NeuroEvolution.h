@@ -5,17 +5,51 @@
 #include "random.h"
 #include "NeuralNetwork.h"
 #include "Snake.h"
+#include "Evaluator.h"
+#include "Population.h"
+#include "Checkpoint.h"
+#include "Migration.h"
+#include "Telemetry.h"
+#include "Trace.h"
 
 namespace NeuroEvolution
 {
+	// Progress lines of the engines on stdout, off for tools with their own output
+	inline bool verbose = true;
+
+	// Genome evolved by the engines: 10 snake sensors, 3 actions
+	using Policy = FixedNeuralNetwork<Snake::sensors, 3>;
+	// Layers of the evolved networks, Policy with the inputs problem senses
+	Topology topology(const SnakeData& problem);
+
 	uint32_t tournament(const std::vector<double>& fitnesses, const uint32_t t_size) noexcept;
+	// Variation on flat genomes, e.g. Population rows
+	void mutate(Population::Genome genome);
+	void cross(const Population::ConstGenome& genome1, const Population::ConstGenome& genome2, Population::Genome res);
 	void mutate(NeuralNetwork& nn);
 	template<typename Distribution = std::uniform_real_distribution<double>>
 	void mutate(NeuralNetwork& nn, Distribution& dis);
+	template<uint32_t... Sizes>
+	void mutate(FixedNeuralNetwork<Sizes...>& nn);
 	NeuralNetwork cross(const NeuralNetwork& nn1, const NeuralNetwork& nn2);
-	NeuralNetwork neuro_evolution(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time);
-	NeuralNetwork neuro_evolution_steady(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time);
-	NeuralNetwork cross_entropy(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const uint32_t elite_size, const double learn_rate, const uint32_t sim_time);
+	template<uint32_t... Sizes>
+	FixedNeuralNetwork<Sizes...> cross(const FixedNeuralNetwork<Sizes...>& nn1, const FixedNeuralNetwork<Sizes...>& nn2);
+	// Writes the child straight into res, which may not alias the parents
+	template<uint32_t... Sizes>
+	void cross(const FixedNeuralNetwork<Sizes...>& nn1, const FixedNeuralNetwork<Sizes...>& nn2, FixedNeuralNetwork<Sizes...>& res);
+	// traces gets the episode of the best genome of every due generation, or round of children
+	// for the steady state engines. With an island the population also exchanges genomes with
+	// the other islands of its mailbox.
+	NeuralNetwork neuro_evolution(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time, const uint32_t threads = 1, const Racing racing = {}, const Caching caching = {}, const Checkpointing& checkpointing = {}, Telemetry* telemetry = nullptr, trace::Writer* traces = nullptr, Island* island = nullptr);
+	NeuralNetwork neuro_evolution_steady(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time, const uint32_t threads = 1, const Racing racing = {}, const Caching caching = {}, const Checkpointing& checkpointing = {}, Telemetry* telemetry = nullptr, trace::Writer* traces = nullptr);
+	// Steady state without rounds: every worker breeds, plays and inserts its own children,
+	// so long episodes never hold up the others. The result depends on thread timing.
+	NeuralNetwork neuro_evolution_async(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float prob_mut, const float prob_cross, const uint32_t t_size, const uint32_t sim_time, const uint32_t threads = 1, const Checkpointing& checkpointing = {}, Telemetry* telemetry = nullptr, trace::Writer* traces = nullptr);
+	NeuralNetwork cross_entropy(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const uint32_t elite_size, const double learn_rate, const uint32_t sim_time, const uint32_t threads = 1, const Racing racing = {}, const Caching caching = {}, const Checkpointing& checkpointing = {}, Telemetry* telemetry = nullptr, trace::Writer* traces = nullptr);
+	// Evolution strategies with mirrored samples: pop_size / 2 noise windows of a shared table,
+	// each played as theta + sigma * noise and theta - sigma * noise, then theta follows the
+	// rank weighted noise with step learn_rate. pop_size has to be even and at least 2.
+	NeuralNetwork evolution_strategies(SnakeData& problem, const uint32_t iterations, const uint32_t pop_size, const float sigma, const double learn_rate, const uint32_t sim_time, const uint32_t threads = 1, const Racing racing = {}, const Caching caching = {}, const Checkpointing& checkpointing = {}, Telemetry* telemetry = nullptr, trace::Writer* traces = nullptr);
 };
 
 template<typename Distribution>
@@ -30,4 +64,24 @@ inline void NeuroEvolution::mutate(NeuralNetwork& nn, Distribution& dis)
 	}
 }
 
+template<uint32_t... Sizes>
+inline void NeuroEvolution::mutate(FixedNeuralNetwork<Sizes...>& nn)
+{
+	NeuroEvolution::mutate(Population::Genome(nn.weights));
+}
+
+template<uint32_t... Sizes>
+inline FixedNeuralNetwork<Sizes...> NeuroEvolution::cross(const FixedNeuralNetwork<Sizes...>& nn1, const FixedNeuralNetwork<Sizes...>& nn2)
+{
+	FixedNeuralNetwork<Sizes...> res(false);
+	cross(nn1, nn2, res);
+	return res;
+}
+
+template<uint32_t... Sizes>
+inline void NeuroEvolution::cross(const FixedNeuralNetwork<Sizes...>& nn1, const FixedNeuralNetwork<Sizes...>& nn2, FixedNeuralNetwork<Sizes...>& res)
+{
+	NeuroEvolution::cross(nn1.weights, nn2.weights, res.weights);
+}
+
 #endif // NEUROEVOLUTION_H
@@ -0,0 +1,18 @@
+#include "NoiseTable.h"
+#include <random>
+
+NoiseTable::NoiseTable(const size_t size, random::Philox rng) :
+	values(size)
+{
+	std::normal_distribution<float> dis(0.0f, 1.0f);
+	for(Eigen::Index i = 0; i < values.size(); ++i)
+	{
+		values[i] = dis(rng);
+	}
+}
+
+uint32_t NoiseTable::offset(random::Philox& rng, const uint32_t length) const
+{
+	assert(length <= size());
+	return std::uniform_int_distribution<uint32_t>(0, size() - length)(rng);
+}
@@ -0,0 +1,33 @@
+#ifndef NOISE_TABLE_H
+#define NOISE_TABLE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <eigen3/Eigen/Core>
+#include "random.h"
+
+// Standard normal samples drawn once and shared by every perturbation of a run. A
+// perturbation is a window of the table at a random offset, so sampling one costs a single
+// random draw instead of one per weight. Windows overlap, which is harmless as long as the
+// table is much longer than a genome.
+struct NoiseTable
+{
+	NoiseTable(const size_t size, random::Philox rng);
+
+	size_t size() const noexcept { return values.size(); }
+	// Start of a window of length samples drawn from rng
+	uint32_t offset(random::Philox& rng, const uint32_t length) const;
+	Eigen::Map<const Eigen::RowVectorXf> window(const uint32_t offset, const uint32_t length) const noexcept;
+
+private:
+	Eigen::VectorXf values;
+};
+
+inline Eigen::Map<const Eigen::RowVectorXf> NoiseTable::window(const uint32_t offset, const uint32_t length) const noexcept
+{
+	assert(size_t(offset) + length <= size());
+	return Eigen::Map<const Eigen::RowVectorXf>(values.data() + offset, length);
+}
+
+#endif // NOISE_TABLE_H
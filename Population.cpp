@@ -0,0 +1,48 @@
+#include "Population.h"
+
+Population::Population(const Topology& topology, const uint32_t size, const bool randomize) :
+	topology(topology),
+	genomes(Genomes::Zero(size, (topology.genomeLength() + row_alignment - 1) / row_alignment * row_alignment))
+{
+	if(randomize)
+	{
+		std::uniform_real_distribution dis(-1.0, 1.0);
+		genomes.leftCols(topology.genomeLength()) = Genomes::NullaryExpr(size, topology.genomeLength(), [&](){return dis(random::random_generator);});
+	}
+}
+
+uint32_t Population::size() const noexcept
+{
+	return genomes.rows();
+}
+
+void Population::resize(const uint32_t size)
+{
+	genomes.resize(size, genomes.cols());
+}
+
+Population::Genome Population::genome(const uint32_t i)
+{
+	return genomes.row(i).head(topology.genomeLength());
+}
+
+Population::ConstGenome Population::genome(const uint32_t i) const
+{
+	return genomes.row(i).head(topology.genomeLength());
+}
+
+NeuralNetworkView Population::operator[](const uint32_t i) const
+{
+	return {&topology, genomes.row(i).data()};
+}
+
+NeuralNetwork Population::network(const uint32_t i) const
+{
+	return NeuralNetwork((*this)[i]);
+}
+
+void Population::swap(Population& other) noexcept
+{
+	assert(topology.sizes == other.topology.sizes);
+	genomes.swap(other.genomes);
+}
@@ -0,0 +1,34 @@
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <cstdint>
+#include <eigen3/Eigen/Core>
+#include "NeuralNetwork.h"
+
+// All genomes of a population in one aligned row major buffer, one padded row per genome.
+// Selection copies, mutation and crossover work on whole rows, swapping two populations
+// only exchanges their buffers.
+struct Population
+{
+	using Genomes = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+	using Genome = Eigen::Ref<Eigen::RowVectorXf>;
+	using ConstGenome = Eigen::Ref<const Eigen::RowVectorXf>;
+	// Rows are padded to a multiple of this many floats (one cache line)
+	static constexpr uint32_t row_alignment = 16;
+
+	Topology topology;
+	Genomes genomes;
+
+	Population(const Topology& topology, const uint32_t size, const bool randomize = true);
+
+	uint32_t size() const noexcept;
+	// Changes the number of genomes, contents are not preserved
+	void resize(const uint32_t size);
+	Genome genome(const uint32_t i);
+	ConstGenome genome(const uint32_t i) const;
+	NeuralNetworkView operator[](const uint32_t i) const;
+	NeuralNetwork network(const uint32_t i) const;
+	void swap(Population& other) noexcept;
+};
+
+#endif // POPULATION_H
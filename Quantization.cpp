@@ -0,0 +1,84 @@
+#include "Quantization.h"
+
+float quantization::quantize(const float* weights, const size_t count, int8_t* out, const size_t stride) noexcept
+{
+	float largest = 0.0f;
+	for(size_t i = 0; i < count; ++i)
+	{
+		largest = std::max(largest, std::abs(weights[i]));
+	}
+	const float scale = largest > 0.0f ? largest / 127.0f : 1.0f;
+	// Half away from zero like fixed, without a library call per weight
+	for(size_t i = 0; i < count; ++i)
+	{
+		const float y = weights[i] / scale;
+		out[i * stride] = static_cast<int8_t>(y + (y < 0.0f ? -0.5f : 0.5f));
+	}
+	return scale;
+}
+
+const int32_t* quantization::sigmoidTable() noexcept
+{
+	static const auto table = []()
+	{
+		std::vector<int32_t> t(2 * sigmoid_range * sigmoid_steps + 1);
+		for(size_t k = 0; k < t.size(); ++k)
+		{
+			const float z = (static_cast<int32_t>(k) - sigmoid_range * sigmoid_steps) / static_cast<float>(sigmoid_steps);
+			t[k] = fixed(sigmoid(z), activation_scale);
+		}
+		return t;
+	}();
+	return table.data();
+}
+
+void QuantizedNetwork::forward(const Eigen::VectorXf& input) const
+{
+	assert(input.size() == inputsCount());
+	for(Eigen::Index i = 0; i < input.size(); ++i)
+	{
+		activations[i] = quantization::fixed(input[i], input_scale);
+	}
+	float in_scale = input_scale;
+	for(uint32_t l = 0; l < weights.size(); ++l)
+	{
+		const uint32_t in_size = sizes[l];
+		const uint32_t out_size = sizes[l + 1];
+		for(uint32_t j = 0; j < out_size; ++j)
+		{
+			int32_t sum = 0;
+			for(uint32_t i = 0; i < in_size; ++i)
+			{
+				sum += static_cast<int32_t>(activations[i]) * weights[l][j * in_size + i];
+			}
+			sums[j] = sum;
+		}
+		if(l + 1 == weights.size()) break;
+		// Same lookup as BatchSimulator::forwardQuantized
+		const int32_t* table = quantization::sigmoidTable();
+		for(uint32_t j = 0; j < out_size; ++j)
+		{
+			activations[j] = quantization::activate(sums[j] * (scales[l] / in_scale), table);
+		}
+		in_scale = quantization::activation_scale;
+	}
+}
+
+Eigen::VectorXf QuantizedNetwork::feedForward(const Eigen::VectorXf& input) const
+{
+	forward(input);
+	const float scale = scales.back() / (weights.size() == 1 ? input_scale : quantization::activation_scale);
+	Eigen::VectorXf res(sizes.back());
+	for(uint32_t j = 0; j < sizes.back(); ++j)
+	{
+		res[j] = sigmoid(sums[j] * scale);
+	}
+	return res;
+}
+
+uint32_t QuantizedNetwork::decide(const Eigen::VectorXf& input) const
+{
+	// One positive scale for the whole layer, so the integer sums rank like the real ones
+	forward(input);
+	return std::max_element(std::begin(sums), std::begin(sums) + sizes.back()) - std::begin(sums);
+}
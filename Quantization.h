@@ -0,0 +1,126 @@
+#ifndef QUANTIZATION_H
+#define QUANTIZATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <eigen3/Eigen/Core>
+#include "NeuralNetwork.h"
+
+// Integer inference for decisions. Weights are int8 with one scale per layer, activations
+// int16 fixed point and sums int32. Integer sums do not depend on their order, so a batch
+// and a single network always take the same decision for the same weights and inputs.
+namespace quantization
+{
+	// Inputs keep up to 6 fraction bits: cell codes are exact, inverse vision distances are
+	// rounded to 1/scale and reward offsets, up to the board extent, are exact while
+	// extent * scale fits int16
+	constexpr float max_input_scale = 64.0f;
+	// Largest power of two up to max_input_scale that keeps offsets of a board extent cells
+	// wide unsaturated: 64 up to 511 cells, 32 on a 1000 cell board, at least 1
+	inline float inputScale(const uint32_t extent) noexcept
+	{
+		float scale = max_input_scale;
+		while(scale > 1.0f && extent * scale > 32767.0f) scale /= 2.0f;
+		return scale;
+	}
+	// Hidden activations are sigmoid outputs in (0, 1)
+	constexpr float activation_scale = 4096.0f;
+
+	// Rounds half away from zero; clamps and truncates, so loops over it vectorise
+	inline int16_t fixed(const float x, const float scale) noexcept
+	{
+		const float y = std::clamp(x * scale, -32767.0f, 32767.0f);
+		return static_cast<int16_t>(y + (y < 0.0f ? -0.5f : 0.5f));
+	}
+
+	// Integer x with unit steps per 1.0, the same value as fixed(x, unit) without floats
+	inline int16_t fixed(const int32_t x, const int32_t unit) noexcept
+	{
+		return static_cast<int16_t>(std::clamp(x * unit, -32767, 32767));
+	}
+
+	// Hidden activations are looked up instead of calling exp: the table holds
+	// fixed(sigmoid(z), activation_scale) at steps of 1/sigmoid_steps for |z| <= sigmoid_range,
+	// off by at most 4 / 4096 from the exact value. The lookup vectorises, and batches and
+	// single networks share the table, so they still agree exactly.
+	constexpr int32_t sigmoid_steps = 128;
+	constexpr int32_t sigmoid_range = 8;
+	// 2 * sigmoid_range * sigmoid_steps + 1 entries, z = 0 in the middle
+	const int32_t* sigmoidTable() noexcept;
+
+	// Fixed point sigmoid of the pre-activation z
+	inline int16_t activate(const float z, const int32_t* table) noexcept
+	{
+		constexpr float half = sigmoid_range * sigmoid_steps;
+		const float k = std::clamp(z * sigmoid_steps, -half, half);
+		return static_cast<int16_t>(table[static_cast<int32_t>(k + (k < 0.0f ? -0.5f : 0.5f)) + sigmoid_range * sigmoid_steps]);
+	}
+
+	// out[i * stride] = round(weights[i] / s) for s = max |weight| / 127, returns s
+	float quantize(const float* weights, const size_t count, int8_t* out, const size_t stride = 1) noexcept;
+
+	// acc[i] += x[i] * w[i]; plain loop that compiles to widening SIMD multiplies
+	inline void accumulate(const int16_t* __restrict x, const int8_t* __restrict w, int32_t* __restrict acc, const size_t count) noexcept
+	{
+		for(size_t i = 0; i < count; ++i)
+		{
+			acc[i] += static_cast<int32_t>(x[i]) * w[i];
+		}
+	}
+};
+
+// Network with int8 weights, made from any network type with layer(l). It only decides,
+// e.g. inside BasicSnakeNN to check quantized policies one decision at a time. Decisions
+// work in buffers sized at construction and never allocate, so one network must not decide
+// on two threads at once.
+struct QuantizedNetwork
+{
+	using Input = Eigen::VectorXf;
+	using Output = Eigen::VectorXf;
+
+	std::vector<uint32_t> sizes;
+	// Layer l row major, weight (i, j) at j * sizes[l] + i as in the float layers
+	std::vector<std::vector<int8_t>> weights;
+	std::vector<float> scales;
+	// Fixed point scale of the inputs, see quantization::inputScale
+	float input_scale;
+
+	template<typename Network>
+	QuantizedNetwork(const Network& nn, const float input_scale);
+
+	uint32_t layersCount() const noexcept { return sizes.size(); }
+	uint32_t inputsCount() const noexcept { return sizes.front(); }
+	// Dequantized outputs with the output activation
+	Eigen::VectorXf feedForward(const Eigen::VectorXf& input) const;
+	uint32_t decide(const Eigen::VectorXf& input) const;
+
+private:
+	// Integer outputs of the last layer before their scale, the first outputs of sums
+	void forward(const Eigen::VectorXf& input) const;
+
+	// Fixed point inputs of the current layer and its integer sums, as wide as the widest layer
+	mutable std::vector<int16_t> activations;
+	mutable std::vector<int32_t> sums;
+};
+
+template<typename Network>
+inline QuantizedNetwork::QuantizedNetwork(const Network& nn, const float input_scale) :
+	input_scale(input_scale)
+{
+	sizes.push_back(nn.inputsCount());
+	for(uint32_t l = 0; l + 1 < nn.layersCount(); ++l)
+	{
+		const auto layer = nn.layer(l);
+		sizes.push_back(layer.cols());
+		auto& w = weights.emplace_back(layer.size());
+		scales.push_back(quantization::quantize(layer.data(), layer.size(), w.data()));
+	}
+	const uint32_t widest = *std::max_element(std::begin(sizes), std::end(sizes));
+	activations.resize(widest);
+	sums.resize(widest);
+}
+
+#endif // QUANTIZATION_H
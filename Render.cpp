@@ -0,0 +1,148 @@
+#include "Render.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fmt/core.h>
+
+render::Canvas::Canvas(const uint32_t board_width, const uint32_t board_height, const Layout& layout) :
+	board_width(board_width),
+	board_height(board_height),
+	layout(layout),
+	tiles(layout.tiles)
+{
+	if(!this->layout.columns)
+	{
+		this->layout.columns = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(double(layout.tiles)))));
+	}
+	const uint32_t columns = std::min(this->layout.columns, std::max(layout.tiles, 1u));
+	const uint32_t rows = (layout.tiles + this->layout.columns - 1) / this->layout.columns;
+	image_width = columns * (board_height * layout.scale + layout.gap) + layout.gap;
+	image_height = rows * (board_width * layout.scale + layout.gap) + layout.gap;
+	rgb.assign(size_t(image_width) * image_height * 3, 0);
+}
+
+void render::Canvas::paint(const uint32_t tile, const std::pair<int32_t, int32_t>& cell, const uint32_t value)
+{
+	const auto& colour = palette[value];
+	const uint32_t left = tile % layout.columns * (board_height * layout.scale + layout.gap) + layout.gap + cell.second * layout.scale;
+	const uint32_t top = tile / layout.columns * (board_width * layout.scale + layout.gap) + layout.gap + cell.first * layout.scale;
+	uint8_t* row = rgb.data() + (size_t(top) * image_width + left) * 3;
+	for(uint32_t i = 0; i < layout.scale; ++i)
+	{
+		row[3 * i] = colour[0];
+		row[3 * i + 1] = colour[1];
+		row[3 * i + 2] = colour[2];
+	}
+	// The other lines of the cell are copies of the first
+	for(uint32_t line = 1; line < layout.scale; ++line)
+	{
+		std::memcpy(row + size_t(line) * image_width * 3, row, layout.scale * 3);
+	}
+}
+
+void render::Canvas::remember(const uint32_t tile, const SnakeData& sd, const Snake& snake)
+{
+	tiles[tile] = {snake.head(), snake.body.back(), sd.reward_location};
+}
+
+void render::Canvas::draw(const uint32_t tile, const SnakeData& sd, const Snake& snake)
+{
+	for(uint32_t x = 0; x < sd.width; ++x)
+	{
+		for(uint32_t y = 0; y < sd.height; ++y)
+		{
+			paint(tile, {int32_t(x), int32_t(y)}, sd.wall(x, y) ? SnakeData::WALL : SnakeData::EMPTY);
+		}
+	}
+	if(sd.reward_location.first >= 0)
+	{
+		paint(tile, sd.reward_location, SnakeData::REWARD);
+	}
+	for(const auto& e : snake.body)
+	{
+		paint(tile, e, SnakeData::SNAKE);
+	}
+	paint(tile, snake.head(), SnakeData::SNAKE_HEAD);
+	remember(tile, sd, snake);
+}
+
+void render::Canvas::update(const uint32_t tile, const SnakeData& sd, const Snake& snake)
+{
+	// A step moves the head, drops the tail unless a reward was eaten and then moves the
+	// reward; every other cell looks as before
+	const Tile& last = tiles[tile];
+	if(last.head != snake.head())
+	{
+		paint(tile, last.head, SnakeData::SNAKE);
+	}
+	if(last.tail != snake.body.back())
+	{
+		paint(tile, last.tail, sd.cell(last.tail.first, last.tail.second));
+	}
+	if(last.reward != sd.reward_location)
+	{
+		if(last.reward.first >= 0)
+		{
+			paint(tile, last.reward, sd.cell(last.reward.first, last.reward.second));
+		}
+		if(sd.reward_location.first >= 0)
+		{
+			paint(tile, sd.reward_location, SnakeData::REWARD);
+		}
+	}
+	paint(tile, snake.head(), SnakeData::SNAKE_HEAD);
+	remember(tile, sd, snake);
+}
+
+render::Sink::Sink(const std::string& path, const Format format) :
+	format(format)
+{
+	if(path == "-")
+	{
+		file = stdout;
+	}
+	else if(!path.empty() && path.back() == '/')
+	{
+		directory = path;
+	}
+	else
+	{
+		file = std::fopen(path.c_str(), "wb");
+	}
+}
+
+render::Sink::~Sink()
+{
+	if(file == stdout)
+	{
+		std::fflush(file);
+	}
+	else if(file)
+	{
+		std::fclose(file);
+	}
+}
+
+bool render::Sink::write(const Canvas& canvas)
+{
+	std::FILE* out = file;
+	if(!directory.empty())
+	{
+		out = std::fopen(fmt::format("{}frame_{:06}.ppm", directory, written).c_str(), "wb");
+		if(!out) return false;
+	}
+	bool ok = true;
+	if(format == Format::PPM || !directory.empty())
+	{
+		const auto header = fmt::format("P6\n{} {}\n255\n", canvas.width(), canvas.height());
+		ok = std::fwrite(header.data(), 1, header.size(), out) == header.size();
+	}
+	const auto& pixels = canvas.pixels();
+	ok = ok && std::fwrite(pixels.data(), 1, pixels.size(), out) == pixels.size();
+	if(out != file)
+	{
+		ok = std::fclose(out) == 0 && ok;
+	}
+	written += ok;
+	return ok;
+}
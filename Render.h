@@ -0,0 +1,99 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Snake.h"
+
+// Headless rendering of many games into one RGB image, one tile per game, for machines
+// without a display. Colours are those of frag.frag and tiles are laid out as the viewer
+// shows a board: x grows downwards, y to the right.
+namespace render
+{
+	// frag.frag colours indexed by SnakeData cell codes
+	constexpr std::array<std::array<uint8_t, 3>, 5> palette = {{
+		{26, 26, 26}, {204, 204, 204}, {204, 102, 102}, {102, 102, 204}, {51, 51, 230}}};
+
+	struct Layout
+	{
+		uint32_t tiles = 1;
+		// Tiles per image row, 0 picks a nearly square grid
+		uint32_t columns = 0;
+		// Pixels per cell side
+		uint32_t scale = 4;
+		// Background pixels between tiles and around the image
+		uint32_t gap = 1;
+	};
+
+	// RGB frame of all tiles. Boards are painted whole once per episode; after that update()
+	// only repaints the few cells a step changes, so a frame costs O(tiles) and nothing is
+	// copied per board.
+	struct Canvas
+	{
+		Canvas(const uint32_t board_width, const uint32_t board_height, const Layout& layout);
+
+		uint32_t width() const noexcept { return image_width; }
+		uint32_t height() const noexcept { return image_height; }
+		// Rows of width() * 3 bytes, top row first
+		const std::vector<uint8_t>& pixels() const noexcept { return rgb; }
+		// Paints the whole board of tile, after reset() and whenever the tile shows a new game
+		void draw(const uint32_t tile, const SnakeData& sd, const Snake& snake);
+		// Repaints the cells that changed since the last draw or update of tile; call it
+		// after every step of the game, skipped steps leave stale cells
+		void update(const uint32_t tile, const SnakeData& sd, const Snake& snake);
+
+	private:
+		struct Tile
+		{
+			std::pair<int32_t, int32_t> head;
+			std::pair<int32_t, int32_t> tail;
+			std::pair<int32_t, int32_t> reward;
+		};
+
+		void paint(const uint32_t tile, const std::pair<int32_t, int32_t>& cell, const uint32_t value);
+		void remember(const uint32_t tile, const SnakeData& sd, const Snake& snake);
+
+		uint32_t board_width;
+		uint32_t board_height;
+		Layout layout;
+		uint32_t image_width;
+		uint32_t image_height;
+		std::vector<uint8_t> rgb;
+		std::vector<Tile> tiles;
+	};
+
+	enum class Format
+	{
+		// Binary PPM (P6) frames
+		PPM,
+		// Headerless rgb24 frames, e.g. for ffmpeg -f rawvideo -pix_fmt rgb24
+		RAW
+	};
+
+	// Destination of the frames. "-" is stdout, a path ending in '/' is a directory that gets
+	// one numbered PPM file per frame, any other path gets all frames one after the other.
+	struct Sink
+	{
+		Sink(const std::string& path, const Format format);
+		Sink(const Sink&) = delete;
+		Sink& operator=(const Sink&) = delete;
+		~Sink();
+
+		bool valid() const noexcept { return file != nullptr || !directory.empty(); }
+		// False on I/O errors
+		bool write(const Canvas& canvas);
+		uint64_t frames() const noexcept { return written; }
+
+	private:
+		std::FILE* file = nullptr;
+		std::string directory;
+		Format format;
+		uint64_t written = 0;
+	};
+};
+
+#endif // RENDER_H
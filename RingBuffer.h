@@ -0,0 +1,125 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+// Double ended queue over one power of two sized block. Once reserved it never allocates,
+// pushing at the front and popping at the back are a single masked index update.
+template<typename T>
+struct RingBuffer
+{
+	using value_type = T;
+	using reference = T&;
+	using const_reference = const T&;
+
+	template<typename Buffer, typename Value>
+	struct Iterator
+	{
+		// Only steps forward, indices make random access cheap through operator[]
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = Value*;
+		using reference = Value&;
+
+		Buffer* buffer;
+		uint32_t index;
+
+		reference operator*() const { return (*buffer)[index]; }
+		pointer operator->() const { return &(*buffer)[index]; }
+		Iterator& operator++() { ++index; return *this; }
+		Iterator operator++(int) { auto res = *this; ++index; return res; }
+		bool operator==(const Iterator& other) const { return index == other.index; }
+		bool operator!=(const Iterator& other) const { return index != other.index; }
+	};
+	using iterator = Iterator<RingBuffer, T>;
+	using const_iterator = Iterator<const RingBuffer, const T>;
+
+	RingBuffer() = default;
+	RingBuffer(std::initializer_list<T> init);
+
+	uint32_t size() const noexcept { return count; }
+	uint32_t capacity() const noexcept { return storage.size(); }
+	bool empty() const noexcept { return count == 0; }
+	reference operator[](const uint32_t i) { return storage[(first + i) & mask]; }
+	const_reference operator[](const uint32_t i) const { return storage[(first + i) & mask]; }
+	reference front() { return storage[first]; }
+	const_reference front() const { return storage[first]; }
+	reference back() { return (*this)[count - 1]; }
+	const_reference back() const { return (*this)[count - 1]; }
+	iterator begin() { return {this, 0}; }
+	iterator end() { return {this, count}; }
+	const_iterator begin() const { return {this, 0}; }
+	const_iterator end() const { return {this, count}; }
+
+	// Rounds capacity up to a power of two, keeps the contents
+	void reserve(const uint32_t capacity);
+	void clear() noexcept { first = 0; count = 0; }
+	void push_front(const T& value);
+	template<typename... Args>
+	reference emplace_front(Args&&... args);
+	void push_back(const T& value);
+	void pop_back() noexcept { assert(count > 0); --count; }
+
+private:
+	std::vector<T> storage;
+	uint32_t mask = 0;
+	uint32_t first = 0;
+	uint32_t count = 0;
+};
+
+template<typename T>
+inline RingBuffer<T>::RingBuffer(std::initializer_list<T> init)
+{
+	reserve(init.size());
+	for(const auto& e : init)
+	{
+		push_back(e);
+	}
+}
+
+template<typename T>
+inline void RingBuffer<T>::reserve(const uint32_t capacity)
+{
+	if(capacity <= storage.size()) return;
+	uint32_t size = 1;
+	while(size < capacity) size <<= 1;
+	std::vector<T> res(size);
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		res[i] = (*this)[i];
+	}
+	storage = std::move(res);
+	mask = size - 1;
+	first = 0;
+}
+
+template<typename T>
+inline void RingBuffer<T>::push_front(const T& value)
+{
+	emplace_front(value);
+}
+
+template<typename T>
+template<typename... Args>
+inline typename RingBuffer<T>::reference RingBuffer<T>::emplace_front(Args&&... args)
+{
+	if(count == storage.size()) reserve(2 * count + 1);
+	first = (first - 1) & mask;
+	++count;
+	return storage[first] = T(std::forward<Args>(args)...);
+}
+
+template<typename T>
+inline void RingBuffer<T>::push_back(const T& value)
+{
+	if(count == storage.size()) reserve(2 * count + 1);
+	storage[(first + count) & mask] = value;
+	++count;
+}
+
+#endif // RING_BUFFER_H
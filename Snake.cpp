@@ -1,4 +1,110 @@
 #include "Snake.h"
+#include <numeric>
+#include "Quantization.h"
+
+namespace
+{
+	// Absolute ray steps clockwise from UP, so ray k of a heading h is compass[(h + k) % 8]
+	constexpr std::pair<int32_t, int32_t> compass[Snake::rays] = {
+		{0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}};
+
+	void assign(std::vector<uint64_t>& plane, const uint64_t bit, const bool value) noexcept
+	{
+		const uint64_t mask = uint64_t(1) << (bit & 63);
+		if(value) plane[bit >> 6] |= mask;
+		else plane[bit >> 6] &= ~mask;
+	}
+
+	// Distance from position from of a line to its nearest set bit in one direction, 0 when
+	// there is none. Whole words are skipped with one count zeros instruction each.
+	uint32_t nearest(const uint64_t* line, const uint32_t words, const uint32_t from, const bool forward) noexcept
+	{
+		if(forward)
+		{
+			const uint32_t start = from + 1;
+			uint32_t w = start >> 6;
+			if(w >= words) return 0;
+			uint64_t bits = line[w] & (~uint64_t(0) << (start & 63));
+			while(!bits)
+			{
+				if(++w == words) return 0;
+				bits = line[w];
+			}
+			return (w << 6) + __builtin_ctzll(bits) - from;
+		}
+		if(from == 0) return 0;
+		const uint32_t start = from - 1;
+		uint32_t w = start >> 6;
+		uint64_t bits = line[w] & (~uint64_t(0) >> (63 - (start & 63)));
+		while(!bits)
+		{
+			if(w-- == 0) return 0;
+			bits = line[w];
+		}
+		return from - ((w << 6) + 63 - __builtin_clzll(bits));
+	}
+
+	// Inverse of a ray distance, 0 when the ray sees nothing
+	float inverse(const uint32_t distance) noexcept
+	{
+		return distance ? 1.0f / distance : 0.0f;
+	}
+
+	// Passes the inputs of observe() in board units to write(index, value): reward offset
+	// rotated to the heading, then the 8 neighbour cells
+	template<typename Write>
+	void readings(const Snake& snake, const SnakeData& state, Write write)
+	{
+		const auto dir = snake.direction();
+		const auto [sx, sy] = snake.head();
+		auto x = sx - state.reward_location.first;
+		auto y = sy - state.reward_location.second;
+		if (dir == Snake::Directions::DOWN)
+		{
+			x = -x;
+			y = -y;
+		}
+		else if (dir == Snake::Directions::RIGHT)
+		{
+			y = -y;
+			std::swap(x, y);
+		}
+		else if (dir == Snake::Directions::LEFT)
+		{
+			x = -x;
+			std::swap(x, y);
+		}
+		const auto cell = [&](const int32_t cx, const int32_t cy) { return static_cast<int32_t>(state.cell(cx, cy)); };
+		write(0, x);
+		write(1, y);
+		write(2, cell(sx+1, sy));
+		write(3, cell(sx, sy+1));
+		write(4, cell(sx-1, sy));
+		write(5, cell(sx, sy-1));
+		write(6, cell(sx+1, sy+1));
+		write(7, cell(sx-1, sy+1));
+		write(8, cell(sx-1, sy-1));
+		write(9, cell(sx+1, sy-1));
+	}
+
+	// Passes the distances look() inverts to write(index, distance): wall, body and reward
+	// per ray, forward first and then clockwise
+	template<typename Write>
+	void distances(const Snake& snake, const SnakeData& state, Write write)
+	{
+		// Compass index of UP, DOWN, LEFT and RIGHT
+		constexpr uint32_t bearing[4] = {0, 4, 6, 2};
+		const auto first = bearing[static_cast<uint32_t>(snake.heading)];
+		const auto [x, y] = snake.head();
+		for(uint32_t k = 0; k < Snake::rays; ++k)
+		{
+			const auto [dx, dy] = compass[(first + k) % Snake::rays];
+			write(3 * k, state.wallDistance(x, y, dx, dy));
+			write(3 * k + 1, state.bodyDistance(x, y, dx, dy));
+			write(3 * k + 2, state.rewardDistance(x, y, dx, dy));
+		}
+	}
+}
 
 Snake::Snake() : body{{1, 0}, {0, 0}} {}
 
@@ -9,6 +115,15 @@ decltype (Snake::body)::const_reference Snake::head() const
 	return body.front();
 }
 
+void Snake::respawn(uint32_t x, uint32_t y)
+{
+	body.clear();
+	body.push_back({x, y});
+	body.push_back({x-1, y});
+	heading = Directions::RIGHT;
+	score = 0;
+}
+
 void Snake::move(uint32_t x, uint32_t y)
 {
 	body.emplace_front(x, y);
@@ -19,64 +134,58 @@ void Snake::removeTail()
 	body.pop_back();
 }
 
-Snake::Directions Snake::direction() const noexcept
+Snake::Actions Snake::doDecision()
 {
-	auto x = body.front().first - (*std::next(body.begin())).first;
-	auto y = body.front().second - (*std::next(body.begin())).second;
-	if(y == 0 && x > 0) return Directions::RIGHT;
-	if(y == 0 && x < 0) return Directions::LEFT;
-	if(x == 0 && y > 0) return Directions::UP;
-	if(x == 0 && y < 0) return Directions::DOWN;
-	else return Directions::NONE;
+	// Per thread rather than per snake, batches keep a Snake for every lane
+	static thread_local random::Philox rng = random::stream(0, 0, 0, random::Purpose::DECISION);
+	std::uniform_int_distribution<uint8_t> dis(0, 2);
+	return static_cast<Snake::Actions>(dis(rng));
 }
 
-bool Snake::selfCollissin()
+void Snake::useCurrentState(const SnakeData& state) {}
+
+void Snake::observe(const SnakeData& state, Eigen::Ref<Eigen::RowVectorXf, 0, Eigen::InnerStride<>> out) const
 {
-	return std::find(std::next(std::begin(body)), std::end(body), body.front()) != std::end(body);
+	readings(*this, state, [&](const uint32_t i, const int32_t value) { out[i] = value; });
 }
 
-Snake::Actions Snake::doDecision()
+void Snake::look(const SnakeData& state, Eigen::Ref<Eigen::RowVectorXf, 0, Eigen::InnerStride<>> out) const
 {
-	std::uniform_int_distribution<uint8_t> dis(0, 2);
-	return static_cast<Snake::Actions>(dis(random::random_generator));
-}
-
-void Snake::doAction(const SnakeData& state)
-{
-	const auto action = doDecision();
-	const auto dir = direction();
-	int8_t dis_x = 0;
-	int8_t dis_y = 0;
-	if( (dir == Directions::UP && action == Actions::FORWARD) || 
-		(dir == Directions::RIGHT && action == Actions::LEFT) || 
-		(dir == Directions::LEFT && action == Actions::RIGHT)) dis_y = 1;
-	else 
-	if( (dir == Directions::DOWN && action == Actions::FORWARD) || 
-		(dir == Directions::RIGHT && action == Actions::RIGHT) || 
-		(dir == Directions::LEFT && action == Actions::LEFT)) dis_y = -1;
-	else 
-	if( (dir == Directions::UP && action == Actions::RIGHT) || 
-		(dir == Directions::RIGHT && action == Actions::FORWARD) || 
-		(dir == Directions::DOWN && action == Actions::LEFT)) dis_x = 1;
-	else
-	if( (dir == Directions::UP && action == Actions::LEFT) || 
-		(dir == Directions::LEFT && action == Actions::FORWARD) || 
-		(dir == Directions::DOWN && action == Actions::RIGHT)) dis_x = -1;
+	distances(*this, state, [&](const uint32_t i, const uint32_t distance) { out[i] = inverse(distance); });
+}
 
-	const auto new_x = body.front().first + dis_x;
-	const auto new_y = body.front().second + dis_y;
-	move(new_x, new_y);
+void Snake::sense(const SnakeData& state, Eigen::Ref<Eigen::RowVectorXf, 0, Eigen::InnerStride<>> out) const
+{
+	assert(out.size() == state.inputs());
+	if(!state.vision)
+	{
+		observe(state, out);
+		return;
+	}
+	observe(state, out.head(sensors));
+	look(state, out.tail(3 * rays));
 }
 
-void Snake::useCurrentState(const SnakeData& state) {}
+void Snake::sense(const SnakeData& state, Eigen::Ref<Eigen::Matrix<int16_t, 1, Eigen::Dynamic>, 0, Eigen::InnerStride<>> out, const float scale) const
+{
+	assert(out.size() == state.inputs());
+	// Board values are integers, so they scale exactly without a float round trip
+	const int32_t unit = scale;
+	readings(*this, state, [&](const uint32_t i, const int32_t value) { out[i] = quantization::fixed(value, unit); });
+	if(!state.vision) return;
+	distances(*this, state, [&](const uint32_t i, const uint32_t distance)
+	{
+		out[sensors + i] = quantization::fixed(inverse(distance), scale);
+	});
+}
 
-SnakeData::SnakeData() : data(10, 10)
+SnakeData::SnakeData()
 {
 	defaultGrid();
 	placeReward();
 }
 
-SnakeData::SnakeData(const uint32_t width, const uint32_t length) : data(width, length)
+SnakeData::SnakeData(const uint32_t width, const uint32_t height) : width(width), height(height)
 {
 	defaultGrid();
 	placeReward();
@@ -84,179 +193,233 @@ SnakeData::SnakeData(const uint32_t width, const uint32_t length) : data(width,
 
 void SnakeData::defaultGrid()
 {
-	data = 0;
-	data.row(0) = 1;
-	data.row(data.rows()-1) = 1;
-	data.col(0) = 1;
-	data.col(data.cols()-1) = 1;
+	line_words = (std::max(width, height) + 63) / 64;
+	occupancy.assign(size_t(height) * line_words, 0);
+	columns.assign(vision ? size_t(width) * line_words : 0, 0);
+	diagonals.assign(vision ? size_t(width + height - 1) * line_words : 0, 0);
+	antidiagonals.assign(vision ? size_t(width + height - 1) * line_words : 0, 0);
+	interior = (width - 2) * (height - 2);
+	cells.resize(interior);
+	position.resize(interior);
+	std::iota(std::begin(cells), std::end(cells), 0);
+	std::iota(std::begin(position), std::end(position), 0);
+	moved.clear();
+	moved.reserve(movedLimit());
+	free_count = interior;
 }
 
-void SnakeData::placeReward()
+float SnakeData::inputScale() const noexcept
 {
-	std::uniform_int_distribution<Eigen::Index> dis_x(1, data.cols()-2);
-	std::uniform_int_distribution<Eigen::Index> dis_y(1, data.rows()-2);
-	reward_location = {dis_x(random::random_generator), dis_y(random::random_generator)};
-	//data(dis_x(random::random_generator), dis_y(random::random_generator)) = REWARD;
+	// Reward offsets reach the extent minus one when the reward is off the board
+	return quantization::inputScale(std::max(width, height));
 }
 
-void SnakeData::placeReward(const Snake& snake)
+void SnakeData::reset(Snake& snake)
 {
-	std::uniform_int_distribution<Eigen::Index> dis_x(1, data.cols()-2);
-	std::uniform_int_distribution<Eigen::Index> dis_y(1, data.rows()-2);
-	do
+	// Covered cells are the only ones with their bit set
+	for(uint32_t p = free_count; p < interior; ++p)
+	{
+		const auto [x, y] = coordinates(cells[p]);
+		mark(x, y, false);
+	}
+	// A permutation and its inverse move the same entries, so this restores the identity
+	if(moved.size() < movedLimit())
+	{
+		for(const auto p : moved)
+		{
+			cells[p] = p;
+			position[p] = p;
+		}
+	}
+	else
+	{
+		std::iota(std::begin(cells), std::end(cells), 0);
+		std::iota(std::begin(position), std::end(position), 0);
+	}
+	moved.clear();
+	free_count = interior;
+	// Vision planes are sized for the mode set when the first episode starts
+	if(vision && columns.empty())
 	{
-		reward_location = {dis_x(random::random_generator), dis_y(random::random_generator)};
+		defaultGrid();
 	}
-	while(std::find(std::begin(snake.body), std::end(snake.body), reward_location) != std::end(snake.body));
+	// Bodies rarely cover a large board, longer ones grow the buffer once and keep it
+	snake.body.reserve(std::min(area(), max_reserved_body));
+	for(const auto& [x, y] : snake.body)
+	{
+		occupy(x, y);
+	}
+	placeReward();
 }
 
-bool SnakeData::collission(const Snake& snake) const
+void SnakeData::placeReward()
 {
-	const auto& [x, y] = snake.body.front();
-	return data(x, y) == WALL;
+	if(free_count == 0)
+	{
+		reward_location = {-1, -1};
+		return;
+	}
+	reward_location = coordinates(cells[std::uniform_int_distribution<uint32_t>(0, free_count - 1)(rng)]);
 }
 
-bool SnakeData::step(Snake& snake)
+bool SnakeData::occupied(const int32_t x, const int32_t y) const noexcept
 {
-	snake.useCurrentState(*this);
-	snake.doAction(*this);
-	//const auto& [x, y] = snake->body.front();
-	if(snake.body.front() == reward_location)
-	{
-		placeReward(snake);
-		++(snake.score);
-	}
-	else
-		snake.removeTail();
-	const bool next = !(collission(snake) || snake.selfCollissin());
-	//if(next == false) snake.score = 0;
-	return next;
+	const uint64_t i = uint64_t(y) * line_words * 64 + x;
+	return (occupancy[i >> 6] >> (i & 63)) & 1;
 }
 
-Eigen::ArrayXXi SnakeData::flatData(const Snake& snake) const
+void SnakeData::occupy(const int32_t x, const int32_t y) noexcept
 {
-	Eigen::ArrayXXi res = data;
-	for(const auto& e : snake.body)
+	// A head that ran into the wall, walls need no bit
+	if(wall(x, y)) return;
+	mark(x, y, true);
+	const auto c = (x - 1) + (y - 1) * (width - 2);
+	const auto p = position[c];
+	if(p < free_count)
 	{
-		res(e.first, e.second) = WALL;
+		exchange(p, --free_count);
 	}
-	return res;
 }
 
-Eigen::ArrayXXi SnakeData::flatDataDisplay(const Snake& snake) const
+void SnakeData::release(const int32_t x, const int32_t y) noexcept
 {
-	Eigen::ArrayXXi res = data;
-	res(reward_location.first, reward_location.second) = REWARD;
-	for(const auto& e : snake.body)
+	// A snake spawned next to the border starts with its tail in the wall
+	if(wall(x, y)) return;
+	mark(x, y, false);
+	const auto c = (x - 1) + (y - 1) * (width - 2);
+	const auto p = position[c];
+	if(p >= free_count)
 	{
-		res(e.first, e.second) = SNAKE;
+		exchange(p, free_count++);
 	}
-	res(snake.head().first, snake.head().second) = SNAKE_HEAD;
-	return res;
 }
 
+std::pair<int32_t, int32_t> SnakeData::coordinates(const uint32_t c) const noexcept
+{
+	return {1 + c % (width - 2), 1 + c / (width - 2)};
+}
 
-SnakeNN::SnakeNN() : Snake() {}
+void SnakeData::mark(const int32_t x, const int32_t y, const bool covered) noexcept
+{
+	const uint64_t line = uint64_t(line_words) * 64;
+	assign(occupancy, y * line + x, covered);
+	if(!vision) return;
+	assign(columns, x * line + y, covered);
+	assign(diagonals, (x - y + height - 1) * line + y, covered);
+	assign(antidiagonals, (x + y) * line + y, covered);
+}
 
-SnakeNN::SnakeNN(uint32_t x, uint32_t y) : Snake(x, y) {}
+void SnakeData::exchange(const uint32_t a, const uint32_t b) noexcept
+{
+	if(a == b) return;
+	const auto ca = cells[a];
+	const auto cb = cells[b];
+	for(const auto p : {a, b})
+	{
+		if(cells[p] == p && moved.size() < movedLimit()) moved.push_back(p);
+	}
+	cells[a] = cb;
+	cells[b] = ca;
+	position[cb] = a;
+	position[ca] = b;
+}
 
-SnakeNN::SnakeNN(std::initializer_list<const uint32_t> sizes) : 
-	nn(sizes), 
-	inputs(*std::begin(sizes)) {}
+bool SnakeData::wall(const int32_t x, const int32_t y) const noexcept
+{
+	// Border coordinates 0 and size-1 both wrap to at least size-2
+	return static_cast<uint32_t>(x - 1) >= width - 2 || static_cast<uint32_t>(y - 1) >= height - 2;
+}
 
-SnakeNN::SnakeNN(const NeuralNetwork& nn) : nn(nn), inputs(nn.weights[0].rows()) {}
+uint32_t SnakeData::wallDistance(const int32_t x, const int32_t y, const int32_t dx, const int32_t dy) const noexcept
+{
+	const int32_t along_x = dx > 0 ? width - 1 - x : dx < 0 ? x : INT32_MAX;
+	const int32_t along_y = dy > 0 ? height - 1 - y : dy < 0 ? y : INT32_MAX;
+	return std::min(along_x, along_y);
+}
 
-SnakeNN::SnakeNN(uint32_t x, uint32_t y, std::initializer_list<const uint32_t> sizes) : 
-	Snake(x, y), 
-	nn(sizes), 
-	inputs(*std::begin(sizes)) {}
+uint32_t SnakeData::bodyDistance(const int32_t x, const int32_t y, const int32_t dx, const int32_t dy) const noexcept
+{
+	// Positions along rows count x, along every other line y
+	const uint64_t line = uint64_t(line_words) * 64;
+	if(dy == 0) return nearest(occupancy.data() + (y * line >> 6), line_words, x, dx > 0);
+	if(dx == 0) return nearest(columns.data() + (x * line >> 6), line_words, y, dy > 0);
+	if(dx == dy) return nearest(diagonals.data() + ((x - y + height - 1) * line >> 6), line_words, y, dy > 0);
+	return nearest(antidiagonals.data() + ((x + y) * line >> 6), line_words, y, dy > 0);
+}
 
-SnakeNN::SnakeNN(uint32_t x, uint32_t y, const NeuralNetwork& nn) : 
-	Snake(x, y), 
-	nn(nn), 
-	inputs(nn.weights[0].rows()) {}
+uint32_t SnakeData::rewardDistance(const int32_t x, const int32_t y, const int32_t dx, const int32_t dy) const noexcept
+{
+	const int32_t rx = reward_location.first - x;
+	const int32_t ry = reward_location.second - y;
+	const int32_t steps = std::max(std::abs(rx), std::abs(ry));
+	if(steps == 0 || rx != dx * steps || ry != dy * steps) return 0;
+	return steps;
+}
 
-Snake::Actions SnakeNN::doDecision()
+uint32_t SnakeData::cell(const int32_t x, const int32_t y) const noexcept
 {
-	auto output = nn.feedForward(inputs);
-	decltype(output)::Index ind;
-	output.maxCoeff(&ind);
-	if(print) fmt::print("Probabilities: {}\n", output.transpose());
-	return static_cast<Snake::Actions>(ind);
+	// The head is never a neighbour, so covered cells always read as body
+	if(occupied(x, y)) return SNAKE;
+	if(x == reward_location.first && y == reward_location.second) return REWARD;
+	return wall(x, y) ? WALL : EMPTY;
 }
 
-void SnakeNN::useCurrentState(const SnakeData& state)
+bool SnakeData::collission(const Snake& snake) const
 {
-	const auto dir = direction();
-	const auto [sx, sy] = head();
-	auto x = sx - state.reward_location.first;
-	auto y = sy - state.reward_location.second;
-	if (dir == Snake::Directions::DOWN)
+	const auto& [x, y] = snake.body.front();
+	return wall(x, y);
+}
+
+bool SnakeData::resolve(Snake& snake)
+{
+	const auto [x, y] = snake.head();
+	const bool rewarded = snake.head() == reward_location;
+	if(!rewarded)
 	{
-		x = -x;
-		y = -y;
+		release(snake.body.back().first, snake.body.back().second);
+		snake.removeTail();
 	}
-	else if (dir == Snake::Directions::RIGHT)
+	// The head is not marked yet, so a set bit means it ran into its own body
+	const bool next = !(collission(snake) || occupied(x, y));
+	occupy(x, y);
+	if(rewarded)
+	{
+		placeReward();
+		++(snake.score);
+	}
+	//if(next == false) snake.score = 0;
+	return next;
+}
+
+Eigen::ArrayXXi SnakeData::grid() const
+{
+	Eigen::ArrayXXi res = Eigen::ArrayXXi::Constant(width, height, WALL);
+	res.block(1, 1, width-2, height-2) = EMPTY;
+	return res;
+}
+
+Eigen::ArrayXXi SnakeData::flatData(const Snake& snake) const
+{
+	Eigen::ArrayXXi res = grid();
+	for(const auto& e : snake.body)
 	{
-		y = -y;
-		std::swap(x, y);
+		res(e.first, e.second) = WALL;
 	}
-	else if (dir == Snake::Directions::LEFT)
+	return res;
+}
+
+Eigen::ArrayXXi SnakeData::flatDataDisplay(const Snake& snake) const
+{
+	Eigen::ArrayXXi res = grid();
+	// No reward is left once the snake fills the board
+	if(reward_location.first >= 0)
 	{
-		x = -x;
-		std::swap(x, y);
+		res(reward_location.first, reward_location.second) = REWARD;
 	}
-	Eigen::ArrayXXi data = state.flatDataDisplay(*this);
-	inputs << 
-		//std::clamp(static_cast<double>(x), -0.9, 0.9), 
-		//std::clamp(static_cast<double>(y), -0.9, 0.9), 
-		x, 
-		y, 
-		data(sx+1, sy), 
-		data(sx, sy+1), 
-		data(sx-1, sy), 
-		data(sx, sy-1),
-		data(sx+1, sy+1), 
-		data(sx-1, sy+1), 
-		data(sx-1, sy-1), 
-		data(sx+1, sy-1);
-}
-
-void SnakeNN::doAction(const SnakeData& state)
-{
-	const auto action = doDecision();
-	const auto dir = direction();
-	int8_t dis_x = 0;
-	int8_t dis_y = 0;
-	if( (dir == Directions::UP && action == Actions::FORWARD) || 
-		(dir == Directions::RIGHT && action == Actions::LEFT) || 
-		(dir == Directions::LEFT && action == Actions::RIGHT)) dis_y = 1;
-	else 
-	if( (dir == Directions::DOWN && action == Actions::FORWARD) || 
-		(dir == Directions::RIGHT && action == Actions::RIGHT) || 
-		(dir == Directions::LEFT && action == Actions::LEFT)) dis_y = -1;
-	else 
-	if( (dir == Directions::UP && action == Actions::RIGHT) || 
-		(dir == Directions::RIGHT && action == Actions::FORWARD) || 
-		(dir == Directions::DOWN && action == Actions::LEFT)) dis_x = 1;
-	else
-	if( (dir == Directions::UP && action == Actions::LEFT) || 
-		(dir == Directions::LEFT && action == Actions::FORWARD) || 
-		(dir == Directions::DOWN && action == Actions::RIGHT)) dis_x = -1;
-
-	const auto x = body.front().first;
-	const auto y = body.front().second;
-	auto new_x = x + dis_x;
-	auto new_y = y + dis_y;
-	/*
-	if(const auto data(state.flatData(*this)); data(new_x, new_y) == SnakeData::WALL)
+	for(const auto& e : snake.body)
 	{
-		if(print) fmt::print("CHEAT\n");
-		if(data(x+1, y) == SnakeData::EMPTY) {new_x = x + 1; new_y = y;}
-		else if(data(x-1, y) == SnakeData::EMPTY) {new_x = x - 1; new_y = y;}
-		else if(data(x, y+1) == SnakeData::EMPTY) {new_x = x; new_y = y + 1;}
-		else if(data(x, y-1) == SnakeData::EMPTY) {new_x = x; new_y = y - 1;}
+		res(e.first, e.second) = SNAKE;
 	}
-	*/
-	move(new_x, new_y);
+	res(snake.head().first, snake.head().second) = SNAKE_HEAD;
+	return res;
 }
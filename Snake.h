@@ -2,17 +2,20 @@
 #define SNAKE_H
 
 #include <cstdint>
-#include <list>
 #include <vector>
 #include <random>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
 #include <eigen3/Eigen/Core>
 #include "NeuralNetwork.h"
+#include "RingBuffer.h"
 #include "random.h"
 
 struct SnakeData;
 
+// Body and heading of a snake. Policies derive from it and provide doDecision() and
+// useCurrentState(); SnakeData::step is a template over the policy, so nothing on the
+// per step path is a virtual call. The base class itself moves at random.
 struct Snake
 {
 	enum class Actions : char
@@ -25,19 +28,53 @@ struct Snake
 		UP, DOWN, LEFT, RIGHT, NONE
 	};
 
-	std::list<std::pair<int32_t, int32_t>> body;
+	// Inputs of observe(), and of sense() with long range vision: 8 rays relative to the
+	// heading, each with the inverse distance to the wall, the body and the reward
+	static constexpr uint32_t sensors = 10;
+	static constexpr uint32_t rays = 8;
+	static constexpr uint32_t vision_sensors = sensors + 3 * rays;
+
+	struct Move
+	{
+		int8_t dx;
+		int8_t dy;
+		Directions heading;
+	};
+	// moves[heading][action]: offset of the new head and the heading after the move
+	static constexpr Move moves[4][3] = {
+		/* UP */    {{0, 1, Directions::UP}, {-1, 0, Directions::LEFT}, {1, 0, Directions::RIGHT}},
+		/* DOWN */  {{0, -1, Directions::DOWN}, {1, 0, Directions::RIGHT}, {-1, 0, Directions::LEFT}},
+		/* LEFT */  {{-1, 0, Directions::LEFT}, {0, -1, Directions::DOWN}, {0, 1, Directions::UP}},
+		/* RIGHT */ {{1, 0, Directions::RIGHT}, {0, 1, Directions::UP}, {0, -1, Directions::DOWN}}};
+
+	// Head at the front, tail at the back; SnakeData::reset sizes it to the board area
+	RingBuffer<std::pair<int32_t, int32_t>> body;
+	// Kept with the body instead of being derived from its first two segments
+	Directions heading = Directions::RIGHT;
 	int32_t score = 0;
 
 	Snake();
 	Snake(uint32_t x, uint32_t y);
 	decltype (body)::const_reference head() const;
+	// Restarts as a two cell snake at (x, y) heading right, keeping the body capacity
+	void respawn(uint32_t x, uint32_t y);
 	void move(uint32_t x, uint32_t y);
 	void removeTail();
 	Directions direction() const noexcept;
-	bool selfCollissin();
-	virtual Actions doDecision();
-	virtual void doAction(const SnakeData& state);
-	virtual void useCurrentState(const SnakeData& state);
+	// Moves the head one cell according to action relative to the current heading
+	void advance(const Actions action);
+	// Writes the 10 sensor inputs (reward offset and 8 neighbours, rotated to the heading)
+	void observe(const SnakeData& state, Eigen::Ref<Eigen::RowVectorXf, 0, Eigen::InnerStride<>> out) const;
+	// Writes the 3 * rays vision inputs, forward first and then clockwise; 0 when a ray
+	// sees no body or reward
+	void look(const SnakeData& state, Eigen::Ref<Eigen::RowVectorXf, 0, Eigen::InnerStride<>> out) const;
+	// Every input the board provides: observe() and, with state.vision, look()
+	void sense(const SnakeData& state, Eigen::Ref<Eigen::RowVectorXf, 0, Eigen::InnerStride<>> out) const;
+	// The same inputs in int16 fixed point, each as quantization::fixed(input, scale) with a
+	// power of two scale of at least 1, written without the float inputs
+	void sense(const SnakeData& state, Eigen::Ref<Eigen::Matrix<int16_t, 1, Eigen::Dynamic>, 0, Eigen::InnerStride<>> out, const float scale) const;
+	Actions doDecision();
+	void useCurrentState(const SnakeData& state);
 };
 
 
@@ -48,39 +85,175 @@ struct SnakeData
 	static constexpr uint32_t REWARD = 2;
 	static constexpr uint32_t SNAKE = 3;
 	static constexpr uint32_t SNAKE_HEAD = 4;
+	// Body capacity reserve() sets up front, the whole area on small boards
+	static constexpr uint32_t max_reserved_body = 4096;
 
-	Eigen::ArrayXXi data = Eigen::ArrayXXi(10, 10);
+	// Board extent including the border. Walls are implicit: the border cells are walls and
+	// nothing else is, so the only per cell state is the body bit plane below.
+	uint32_t width = 10;
+	uint32_t height = 10;
+	// Snakes also sense long range vision, set before the first reset
+	bool vision = false;
+	// Evaluations decide with int8 weights and integer sums, see Quantization.h
+	bool quantized = false;
 	std::pair<int32_t, int32_t> reward_location;
+	// Bit planes set while a snake segment covers a cell, every line starts on a word.
+	// occupancy has a line per row; with vision the body is also kept per column, diagonal
+	// (x - y constant) and anti diagonal (x + y constant), so a ray finds the nearest
+	// segment with a few find first set instructions instead of walking the board.
+	std::vector<uint64_t> occupancy;
+	std::vector<uint64_t> columns;
+	std::vector<uint64_t> diagonals;
+	std::vector<uint64_t> antidiagonals;
+	// Words per line of every plane
+	uint32_t line_words = 1;
+	// Reward placement stream, evaluators key it per episode so runs can be replayed
+	random::Philox rng = random::stream(0, 0, 0, random::Purpose::SIMULATION);
 
 	SnakeData();
-	SnakeData(const uint32_t width, const uint32_t length);
+	SnakeData(const uint32_t width, const uint32_t height);
 
+	uint32_t area() const noexcept { return width * height; }
+	uint32_t inputs() const noexcept { return vision ? Snake::vision_sensors : Snake::sensors; }
+	// Fixed point scale of quantized inputs, small enough for the reward offsets of this board
+	float inputScale() const noexcept;
 	void defaultGrid();
+	// Starts an episode for snake: clears the occupancy, marks its body and places a reward
+	void reset(Snake& snake);
+	// Places the reward on a uniformly drawn free cell in constant time; with no free cell
+	// left it goes off the board
 	void placeReward();
-	void placeReward(const Snake& snake);
+	// Interior cells not covered by the snake
+	uint32_t freeCells() const noexcept { return free_count; }
+	bool occupied(const int32_t x, const int32_t y) const noexcept;
+	// Border test, one unsigned compare per axis
+	bool wall(const int32_t x, const int32_t y) const noexcept;
+	// Steps from (x, y) along (dx, dy) to the first wall, body segment or the reward; 0 when
+	// the ray meets no body segment or reward. Needs vision for rays off the row.
+	uint32_t wallDistance(const int32_t x, const int32_t y, const int32_t dx, const int32_t dy) const noexcept;
+	uint32_t bodyDistance(const int32_t x, const int32_t y, const int32_t dx, const int32_t dy) const noexcept;
+	uint32_t rewardDistance(const int32_t x, const int32_t y, const int32_t dx, const int32_t dy) const noexcept;
+	void occupy(const int32_t x, const int32_t y) noexcept;
+	void release(const int32_t x, const int32_t y) noexcept;
+	// Cell code as flatDataDisplay would show it, read from the maintained board state
+	uint32_t cell(const int32_t x, const int32_t y) const noexcept;
 	bool collission(const Snake& snake) const;
-	bool step(Snake& snake);
+	// Senses, decides and moves policy, a Snake or a type derived from it; it has to be
+	// reset() on this board before the first step
+	template<typename Policy>
+	bool step(Policy& snake);
+	// Reward, tail and collision handling after the snake has moved; false when the episode ends
+	bool resolve(Snake& snake);
+	// Full grid copies for rendering and debugging, the simulation never builds them
+	Eigen::ArrayXXi grid() const;
 	Eigen::ArrayXXi flatData(const Snake& snake) const;
 	Eigen::ArrayXXi flatDataDisplay(const Snake& snake) const;
+
+private:
+	// Board coordinates of interior cell c
+	std::pair<int32_t, int32_t> coordinates(const uint32_t c) const noexcept;
+	// Sets or clears the bits of (x, y) in every maintained plane
+	void mark(const int32_t x, const int32_t y, const bool covered) noexcept;
+	void exchange(const uint32_t a, const uint32_t b) noexcept;
+	uint32_t movedLimit() const noexcept { return interior / 8 + 1; }
+
+	// Permutation of the interior cells, free ones first. position[c] is where interior cell
+	// c sits in it, so covering or freeing a cell is one swap across the free_count boundary.
+	// Every episode starts from the identity, which keeps placement a function of the board
+	// alone, whatever episodes the same SnakeData played before.
+	std::vector<uint32_t> cells;
+	std::vector<uint32_t> position;
+	// Positions that left the identity this episode, reset restores only these. It holds at
+	// most an eighth of the interior; once full, reset rewrites the whole permutation, which
+	// the episode has paid for with as many steps
+	std::vector<uint32_t> moved;
+	uint32_t interior = 0;
+	uint32_t free_count = 0;
 };
 
+inline Snake::Directions Snake::direction() const noexcept
+{
+	return heading;
+}
+
+inline void Snake::advance(const Actions action)
+{
+	const auto& m = moves[static_cast<uint32_t>(heading)][static_cast<uint32_t>(action)];
+	move(body.front().first + m.dx, body.front().second + m.dy);
+	heading = m.heading;
+}
+
+template<typename Policy>
+inline bool SnakeData::step(Policy& snake)
+{
+	snake.useCurrentState(*this);
+	snake.advance(snake.doDecision());
+	return resolve(snake);
+}
+
 
-struct SnakeNN final : Snake
+// Snake driven by a neural network policy, Network is NeuralNetwork or a FixedNeuralNetwork
+template<typename Network>
+struct BasicSnakeNN final : Snake
 {
-	NeuralNetwork nn;
-	Eigen::VectorXf inputs;
+	Network nn;
+	typename Network::Input inputs;
 	bool print = false;
 
-	SnakeNN();
-	SnakeNN(uint32_t x, uint32_t y);
-	SnakeNN(std::initializer_list<const uint32_t> sizes);
-	SnakeNN(const NeuralNetwork& nn);
-	SnakeNN(uint32_t x, uint32_t y, std::initializer_list<const uint32_t> sizes);
-	SnakeNN(uint32_t x, uint32_t y, const NeuralNetwork& nn);
+	BasicSnakeNN();
+	BasicSnakeNN(uint32_t x, uint32_t y);
+	BasicSnakeNN(std::initializer_list<const uint32_t> sizes);
+	BasicSnakeNN(const Network& nn);
+	BasicSnakeNN(uint32_t x, uint32_t y, std::initializer_list<const uint32_t> sizes);
+	BasicSnakeNN(uint32_t x, uint32_t y, const Network& nn);
 	
-	Actions doDecision() override;
-	void useCurrentState(const SnakeData& state) override;
-	void doAction(const SnakeData& state) override;
+	Actions doDecision();
+	void useCurrentState(const SnakeData& state);
 };
 
+using SnakeNN = BasicSnakeNN<NeuralNetwork>;
+
+template<typename Network>
+inline BasicSnakeNN<Network>::BasicSnakeNN() : Snake() {}
+
+template<typename Network>
+inline BasicSnakeNN<Network>::BasicSnakeNN(uint32_t x, uint32_t y) : Snake(x, y) {}
+
+template<typename Network>
+inline BasicSnakeNN<Network>::BasicSnakeNN(std::initializer_list<const uint32_t> sizes) : 
+	nn(sizes), 
+	inputs(*std::begin(sizes)) {}
+
+template<typename Network>
+inline BasicSnakeNN<Network>::BasicSnakeNN(const Network& nn) : nn(nn), inputs(nn.inputsCount()) {}
+
+template<typename Network>
+inline BasicSnakeNN<Network>::BasicSnakeNN(uint32_t x, uint32_t y, std::initializer_list<const uint32_t> sizes) : 
+	Snake(x, y), 
+	nn(sizes), 
+	inputs(*std::begin(sizes)) {}
+
+template<typename Network>
+inline BasicSnakeNN<Network>::BasicSnakeNN(uint32_t x, uint32_t y, const Network& nn) : 
+	Snake(x, y), 
+	nn(nn), 
+	inputs(nn.inputsCount()) {}
+
+template<typename Network>
+inline Snake::Actions BasicSnakeNN<Network>::doDecision()
+{
+	if(print)
+	{
+		const auto output = nn.feedForward(inputs);
+		fmt::print("Probabilities: {}\n", Eigen::Map<const Eigen::RowVectorXf>(output.data(), output.size()));
+	}
+	return static_cast<Snake::Actions>(nn.decide(inputs));
+}
+
+template<typename Network>
+inline void BasicSnakeNN<Network>::useCurrentState(const SnakeData& state)
+{
+	sense(state, inputs);
+}
+
 #endif // SNAKE_H
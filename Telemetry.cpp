@@ -0,0 +1,105 @@
+#include "Telemetry.h"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <fmt/format.h>
+#include "AllocationCounter.h"
+
+double Telemetry::Stopwatch::lap() noexcept
+{
+	const auto now = Clock::now();
+	const double res = std::chrono::duration<double>(now - last).count();
+	last = now;
+	return res;
+}
+
+Telemetry::Telemetry(const std::string& path, const uint32_t capacity) :
+	file(std::fopen(path.c_str(), "w")),
+	capacity(capacity)
+{
+	queue.reserve(capacity);
+	if(file)
+	{
+		writer = std::thread(&Telemetry::write, this);
+	}
+}
+
+Telemetry::~Telemetry()
+{
+	{
+		std::lock_guard lock(mutex);
+		stop = true;
+	}
+	wake.notify_one();
+	if(writer.joinable())
+	{
+		writer.join();
+	}
+	if(file)
+	{
+		std::fclose(file);
+	}
+}
+
+void Telemetry::summarise(const std::vector<double>& fitnesses, Record& record)
+{
+	if(fitnesses.empty()) return;
+	scratch.assign(std::begin(fitnesses), std::end(fitnesses));
+	const auto middle = std::begin(scratch) + scratch.size() / 2;
+	std::nth_element(std::begin(scratch), middle, std::end(scratch));
+	record.median = *middle;
+	record.best = *std::max_element(middle, std::end(scratch));
+	record.mean = std::accumulate(std::begin(scratch), std::end(scratch), 0.0) / scratch.size();
+}
+
+void Telemetry::push(const Record& record)
+{
+	if(!file) return;
+	{
+		std::lock_guard lock(mutex);
+		if(queue.size() == capacity)
+		{
+			++dropped;
+			return;
+		}
+		queue.push_front(record);
+	}
+	wake.notify_one();
+}
+
+void Telemetry::write()
+{
+	fmt::memory_buffer line;
+	while(true)
+	{
+		Record r;
+		uint64_t lost;
+		{
+			std::unique_lock lock(mutex);
+			wake.wait(lock, [this](){ return stop || !queue.empty(); });
+			if(queue.empty())
+			{
+				std::fflush(file);
+				return;
+			}
+			r = queue.back();
+			queue.pop_back();
+			// Each line reports the records dropped since the line before it
+			lost = std::exchange(dropped, 0);
+		}
+		const double phases = r.evaluation + r.selection + r.crossover + r.mutation;
+		// null rather than 0 when the build does not count allocations
+		const auto allocated = allocations::supported() ? fmt::format("{}", r.allocations) : std::string("null");
+		line.clear();
+		fmt::format_to(std::back_inserter(line),
+			"{{\"generation\":{},\"best\":{},\"mean\":{},\"median\":{},"
+			"\"episodes\":{},\"timeouts\":{},\"episode_length\":{:.3f},"
+			"\"evaluation\":{:.6f},\"selection\":{:.6f},\"crossover\":{:.6f},\"mutation\":{:.6f},\"other\":{:.6f},\"wall\":{:.6f},"
+			"\"steps\":{},\"steps_per_second\":{:.1f},\"allocations\":{},\"dropped\":{}}}\n",
+			r.generation, r.best, r.mean, r.median,
+			r.episodes, r.timeouts, static_cast<double>(r.steps) / std::max<uint64_t>(r.episodes, 1),
+			r.evaluation, r.selection, r.crossover, r.mutation, std::max(r.wall - phases, 0.0), r.wall,
+			r.steps, r.evaluation > 0.0 ? r.steps / r.evaluation : 0.0, allocated, lost);
+		std::fwrite(line.data(), 1, line.size(), file);
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RingBuffer.h"
+
+// JSON lines stream with one record per generation. Engines only copy a record into a
+// preallocated queue; formatting and file I/O happen on a background writer thread.
+// When the writer falls behind records are dropped rather than stalling training.
+struct Telemetry
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Record
+	{
+		// Generation, or round of children for the steady state engines
+		uint64_t generation = 0;
+		double best = 0.0;
+		double mean = 0.0;
+		double median = 0.0;
+		// Episodes played, those still alive at the step limit and their total length
+		uint64_t episodes = 0;
+		uint64_t timeouts = 0;
+		uint64_t steps = 0;
+		// Seconds per phase, summed over workers for the async engine
+		double evaluation = 0.0;
+		double selection = 0.0;
+		double crossover = 0.0;
+		double mutation = 0.0;
+		// Seconds the whole generation took
+		double wall = 0.0;
+		uint64_t allocations = 0;
+	};
+
+	// Seconds since the previous lap, for timing consecutive phases
+	struct Stopwatch
+	{
+		Clock::time_point last = Clock::now();
+
+		double lap() noexcept;
+	};
+
+	explicit Telemetry(const std::string& path, const uint32_t capacity = 1024);
+	Telemetry(const Telemetry&) = delete;
+	Telemetry& operator=(const Telemetry&) = delete;
+	// Writes the queued records and closes the file
+	~Telemetry();
+
+	bool valid() const noexcept { return file != nullptr; }
+	// Fills best, mean and median of record, median uses a preallocated scratch buffer
+	void summarise(const std::vector<double>& fitnesses, Record& record);
+	// Queues record for the writer, never blocks on I/O and never allocates
+	void push(const Record& record);
+
+private:
+	void write();
+
+	std::FILE* file = nullptr;
+	std::vector<double> scratch;
+	std::mutex mutex;
+	std::condition_variable wake;
+	RingBuffer<Record> queue;
+	uint32_t capacity;
+	// Records dropped since the last written line
+	uint64_t dropped = 0;
+	bool stop = false;
+	std::thread writer;
+};
+
+#endif // TELEMETRY_H
@@ -0,0 +1,89 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(const uint32_t threads)
+{
+	// Worker streams are derived from the caller's generator, so seeding it seeds the whole pool
+	const uint64_t base = (static_cast<uint64_t>(random::random_generator()) << 32) | random::random_generator();
+	workers.reserve(threads > 1 ? threads - 1 : 0);
+	for(uint32_t i = 1; i < threads; ++i)
+	{
+		workers.emplace_back([this, base, i]()
+		{
+			random::seed(base, i);
+			work(i);
+		});
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+	for(auto& t : workers)
+	{
+		t.join();
+	}
+}
+
+uint32_t ThreadPool::size() const noexcept
+{
+	return workers.size() + 1;
+}
+
+void ThreadPool::run(const uint32_t count, const Invoke invoke, const void* task)
+{
+	if(workers.empty())
+	{
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			invoke(task, i, 0);
+		}
+		return;
+	}
+	{
+		std::lock_guard lock(mutex);
+		this->invoke = invoke;
+		this->task = task;
+		this->count = count;
+		next = 0;
+		busy = workers.size();
+		++epoch;
+	}
+	wake.notify_all();
+	drain(0);
+	std::unique_lock lock(mutex);
+	done.wait(lock, [this](){ return busy == 0; });
+	this->invoke = nullptr;
+	this->task = nullptr;
+}
+
+void ThreadPool::work(const uint32_t worker)
+{
+	uint64_t seen = 0;
+	while(true)
+	{
+		{
+			std::unique_lock lock(mutex);
+			wake.wait(lock, [&](){ return stop || epoch != seen; });
+			if(stop) return;
+			seen = epoch;
+		}
+		drain(worker);
+		{
+			std::lock_guard lock(mutex);
+			--busy;
+		}
+		done.notify_one();
+	}
+}
+
+void ThreadPool::drain(const uint32_t worker)
+{
+	for(uint32_t i = next++; i < count; i = next++)
+	{
+		invoke(task, i, worker);
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <type_traits>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "random.h"
+
+// Fixed set of workers executing index ranges. The calling thread acts as worker 0,
+// so a pool of size 1 runs everything inline without spawning threads.
+struct ThreadPool
+{
+	explicit ThreadPool(const uint32_t threads = 1);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	uint32_t size() const noexcept;
+	// Calls task(index, worker) for every index in [0, count) and waits for completion.
+	// The task is passed by reference without type erasure, so dispatch never allocates.
+	template<typename Task>
+	void parallel_for(const uint32_t count, const Task& task);
+
+private:
+	using Invoke = void (*)(const void* task, uint32_t index, uint32_t worker);
+
+	void run(const uint32_t count, const Invoke invoke, const void* task);
+	void work(const uint32_t worker);
+	void drain(const uint32_t worker);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	Invoke invoke = nullptr;
+	const void* task = nullptr;
+	uint32_t count = 0;
+	std::atomic<uint32_t> next{0};
+	uint32_t busy = 0;
+	uint64_t epoch = 0;
+	bool stop = false;
+};
+
+template<typename Task>
+inline void ThreadPool::parallel_for(const uint32_t count, const Task& task)
+{
+	run(count, [](const void* task, uint32_t index, uint32_t worker)
+	{
+		(*static_cast<const Task*>(task))(index, worker);
+	}, &task);
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,126 @@
+#include "Trace.h"
+#include <cerrno>
+#include <cstring>
+#include <fmt/core.h>
+
+Snake::Actions trace::Trace::action(const uint32_t step) const noexcept
+{
+	return static_cast<Snake::Actions>((actions[step >> 2] >> ((step & 3) * 2)) & 3);
+}
+
+void trace::Trace::push(const Snake::Actions action)
+{
+	const uint32_t step = header.steps;
+	if((step & 3) == 0)
+	{
+		actions.push_back(0);
+	}
+	actions.back() |= static_cast<uint8_t>(action) << ((step & 3) * 2);
+}
+
+void trace::Trace::reward(const std::pair<int32_t, int32_t>& location)
+{
+	rewards.push_back({static_cast<int16_t>(location.first), static_cast<int16_t>(location.second)});
+	++header.rewards;
+}
+
+trace::Writer::Writer(const std::string& path, const uint32_t interval) :
+	name(path),
+	file(std::fopen(path.c_str(), "wb")),
+	interval(interval) {}
+
+trace::Writer::~Writer()
+{
+	if(file && std::fclose(file) != 0 && !failed)
+	{
+		fmt::print(stderr, "Cannot write traces {}: {}\n", name, std::strerror(errno));
+	}
+}
+
+bool trace::Writer::write(const Trace& trace)
+{
+	if(!file) return false;
+	std::lock_guard lock(mutex);
+	// A failed write leaves a partial trace that read() reports as truncated, traces after
+	// it would not line up, so the file takes none
+	if(failed) return false;
+	failed = std::fwrite(&trace.header, sizeof(trace.header), 1, file) != 1 ||
+		std::fwrite(trace.rewards.data(), sizeof(trace.rewards.front()), trace.rewards.size(), file) != trace.rewards.size() ||
+		std::fwrite(trace.actions.data(), 1, trace.actions.size(), file) != trace.actions.size() ||
+		std::fflush(file) != 0;
+	return !failed;
+}
+
+bool trace::read(const std::string& path, std::vector<Trace>& traces, std::string& error)
+{
+	error.clear();
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+	if(!file)
+	{
+		error = fmt::format("cannot open {}: {}", path, std::strerror(errno));
+		return false;
+	}
+	traces.clear();
+	// Sizes in a header are checked against the rest of the file before allocating
+	std::fseek(file, 0, SEEK_END);
+	const long size = std::ftell(file);
+	std::rewind(file);
+	Header h;
+	while(std::fread(&h, sizeof(h), 1, file) == 1)
+	{
+		if(std::memcmp(h.magic, magic, sizeof(h.magic)) != 0 || h.version != version)
+		{
+			error = fmt::format("trace {} of {} has a bad header", traces.size(), path);
+			break;
+		}
+		const uint64_t rewards = uint64_t(h.rewards) * sizeof(decltype(Trace::rewards)::value_type);
+		const uint64_t actions = (uint64_t(h.steps) + 3) / 4;
+		const long position = std::ftell(file);
+		if(size < 0 || position < 0 || rewards + actions > uint64_t(size - position))
+		{
+			error = fmt::format("trace {} of {} is truncated", traces.size(), path);
+			break;
+		}
+		auto& t = traces.emplace_back();
+		t.header = h;
+		t.rewards.resize(h.rewards);
+		t.actions.resize(actions);
+		if(std::fread(t.rewards.data(), sizeof(t.rewards.front()), h.rewards, file) != h.rewards ||
+			std::fread(t.actions.data(), 1, t.actions.size(), file) != t.actions.size())
+		{
+			error = fmt::format("trace {} of {} is truncated", traces.size() - 1, path);
+			traces.pop_back();
+			break;
+		}
+	}
+	std::fclose(file);
+	return error.empty();
+}
+
+trace::Player::Player(const Trace& trace) :
+	trace(trace),
+	sd(trace.header.width, trace.header.height),
+	s(trace.header.x, trace.header.y)
+{
+	sd.reset(s);
+	if(!trace.rewards.empty())
+	{
+		sd.reward_location = {trace.rewards.front()[0], trace.rewards.front()[1]};
+		rewarded = 1;
+	}
+}
+
+bool trace::Player::next()
+{
+	if(done()) return false;
+	s.advance(trace.action(current++));
+	const auto score = s.score;
+	alive = sd.resolve(s);
+	// The board drew its own reward, the recorded one replaces it
+	if(s.score != score && rewarded < trace.rewards.size())
+	{
+		const auto& r = trace.rewards[rewarded++];
+		sd.reward_location = {r[0], r[1]};
+	}
+	return true;
+}
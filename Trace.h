@@ -0,0 +1,170 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <eigen3/Eigen/Core>
+#include "Quantization.h"
+#include "Snake.h"
+
+// Compact replay of one episode: board size, start cell, every reward placement and a 2 bit
+// code per action. That is enough to rebuild every frame without the network or the random
+// streams, a 1000 step episode takes about 300 bytes. Trace files are a plain sequence of
+// traces, each a header followed by its rewards and packed actions.
+namespace trace
+{
+	constexpr char magic[8] = {'S', 'N', 'A', 'K', 'E', 'T', 'R', '\0'};
+	constexpr uint32_t version = 1;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint16_t width;
+		uint16_t height;
+		// Cell of the head, the tail starts left of it
+		uint16_t x;
+		uint16_t y;
+		// Stream key the episode was played on, with run_seed it identifies the episode
+		uint32_t generation;
+		uint32_t genome;
+		uint32_t episode;
+		uint64_t run_seed;
+		uint32_t steps;
+		uint32_t rewards;
+		int32_t score;
+		// Episode ended at the step limit rather than in a collision
+		uint32_t timed_out;
+	};
+	static_assert(sizeof(Header) == 56, "trace header layout is part of the file format");
+
+	struct Trace
+	{
+		Header header{};
+		// Initial reward first, then one entry per reward eaten; -1 when the board was full
+		std::vector<std::array<int16_t, 2>> rewards;
+		// Four actions per byte, the first in the low bits
+		std::vector<uint8_t> actions;
+
+		Snake::Actions action(const uint32_t step) const noexcept;
+		void push(const Snake::Actions action);
+		void reward(const std::pair<int32_t, int32_t>& location);
+	};
+
+	// Plays episode of genome as BatchSimulator does, on the same stream, and records it.
+	// Network is any network type BasicSnakeNN accepts, e.g. a Population row. A quantized
+	// problem plays the int8 copy of nn, whose decisions its fitness came from.
+	template<typename Network>
+	Trace record(const SnakeData& problem, const Network& nn, const uint32_t sim_time, const uint32_t generation, const uint32_t genome, const uint32_t episode = 0);
+	// Same episode decided by nn as given
+	template<typename Network>
+	Trace recordEpisode(const SnakeData& problem, const Network& nn, const uint32_t sim_time, const uint32_t generation, const uint32_t genome, const uint32_t episode);
+
+	// Appends traces to a file; write() may be called from several threads
+	struct Writer
+	{
+		// Engines trace every interval-th generation
+		explicit Writer(const std::string& path, const uint32_t interval = 1);
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+		~Writer();
+
+		bool valid() const noexcept { return file != nullptr; }
+		const std::string& path() const noexcept { return name; }
+		bool due(const uint64_t generation) const noexcept { return interval && !(generation % interval); }
+		// Appends and flushes trace, false when it could not be written completely; no later
+		// trace is written then
+		bool write(const Trace& trace);
+
+	private:
+		std::string name;
+		std::FILE* file;
+		std::mutex mutex;
+		uint32_t interval;
+		bool failed = false;
+	};
+
+	// Reads every trace of path, false with the reason in error on missing or damaged files
+	bool read(const std::string& path, std::vector<Trace>& traces, std::string& error);
+
+	// Rebuilds the frames of a trace. Actions and rewards come from the trace, so nothing is
+	// evaluated and no random stream is needed.
+	struct Player
+	{
+		explicit Player(const Trace& trace);
+
+		const SnakeData& board() const noexcept { return sd; }
+		const Snake& snake() const noexcept { return s; }
+		uint32_t step() const noexcept { return current; }
+		bool done() const noexcept { return !alive || current == trace.header.steps; }
+		// Applies the next recorded action, false once the trace has ended
+		bool next();
+		Eigen::ArrayXXi frame() const { return sd.flatDataDisplay(s); }
+
+	private:
+		const Trace& trace;
+		SnakeData sd;
+		Snake s;
+		uint32_t current = 0;
+		uint32_t rewarded = 0;
+		bool alive = true;
+	};
+};
+
+template<typename Network>
+inline trace::Trace trace::record(const SnakeData& problem, const Network& nn, const uint32_t sim_time, const uint32_t generation, const uint32_t genome, const uint32_t episode)
+{
+	if(problem.quantized)
+	{
+		return recordEpisode(problem, QuantizedNetwork(nn, problem.inputScale()), sim_time, generation, genome, episode);
+	}
+	return recordEpisode(problem, nn, sim_time, generation, genome, episode);
+}
+
+template<typename Network>
+inline trace::Trace trace::recordEpisode(const SnakeData& problem, const Network& nn, const uint32_t sim_time, const uint32_t generation, const uint32_t genome, const uint32_t episode)
+{
+	Trace res;
+	SnakeData sd = problem;
+	sd.rng = random::stream(generation, genome, episode, random::Purpose::SIMULATION);
+	std::uniform_int_distribution<uint32_t> pos_x(1, sd.width-2), pos_y(1, sd.height-2);
+	const auto x = pos_x(sd.rng);
+	BasicSnakeNN<Network> snake(x, pos_y(sd.rng), nn);
+	sd.reset(snake);
+
+	auto& h = res.header;
+	std::copy(std::begin(magic), std::end(magic), h.magic);
+	h.version = version;
+	h.width = sd.width;
+	h.height = sd.height;
+	h.x = snake.head().first;
+	h.y = snake.head().second;
+	h.generation = generation;
+	h.genome = genome;
+	h.episode = episode;
+	h.run_seed = random::run_seed;
+	res.reward(sd.reward_location);
+	bool alive = true;
+	for(; alive && h.steps < sim_time; ++h.steps)
+	{
+		snake.useCurrentState(sd);
+		const auto action = snake.doDecision();
+		res.push(action);
+		snake.advance(action);
+		const auto score = snake.score;
+		alive = sd.resolve(snake);
+		if(snake.score != score)
+		{
+			res.reward(sd.reward_location);
+		}
+	}
+	h.score = snake.score;
+	h.timed_out = alive;
+	return res;
+}
+
+#endif // TRACE_H
@@ -0,0 +1,316 @@
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+#include "NeuralNetwork.h"
+#include "Snake.h"
+#include "Evaluator.h"
+#include "Population.h"
+#include "NeuroEvolution.h"
+
+// Benchmark suite. Micro benchmarks repeat one operation until --min-time has passed,
+// macro benchmarks run a fixed workload once. Every run starts from the same seed, results
+// go to stdout as a table and to --output as one JSON object per line.
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Options
+	{
+		double min_time = 0.5;
+		uint32_t threads = 1;
+		uint64_t seed = 1;
+		std::string filter;
+		std::string output = "bench.jsonl";
+	};
+
+	struct Result
+	{
+		std::string_view name;
+		// What one op is: steps, decisions, calls, generations...
+		std::string_view unit;
+		uint64_t ops;
+		double seconds;
+	};
+
+	// Keeps the compiler from dropping computations whose result is unused
+	template<typename T>
+	inline void keep(const T& value)
+	{
+		asm volatile("" : : "r"(&value) : "memory");
+	}
+
+	double since(const Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	struct Suite
+	{
+		Options options;
+		std::FILE* output = nullptr;
+
+		bool selected(const std::string_view name) const
+		{
+			return name.find(options.filter) != std::string_view::npos;
+		}
+
+		// Every benchmark starts from the same generator state
+		void reseed() const
+		{
+			random::run_seed = options.seed;
+			random::use(0, 0, 0, random::Purpose::INITIALIZATION);
+		}
+
+		void report(const Result& res) const
+		{
+			const double per_second = res.ops / res.seconds;
+			const double ns_per_op = 1e9 * res.seconds / res.ops;
+			fmt::print("{:<28} {:>14.0f} {}/s {:>12.1f} ns/op\n", res.name, per_second, res.unit, ns_per_op);
+			fmt::print(output, "{{\"benchmark\":\"{}\",\"unit\":\"{}\",\"ops\":{},\"seconds\":{:.6f},\"per_second\":{:.3f},\"ns_per_op\":{:.3f},\"threads\":{},\"seed\":{}}}\n",
+				res.name, res.unit, res.ops, res.seconds, per_second, ns_per_op, options.threads, options.seed);
+			std::fflush(output);
+		}
+
+		// body(n) performs about n ops and returns how many it did; batches double until
+		// min_time is reached
+		template<typename Body>
+		void micro(const std::string_view name, const std::string_view unit, Body body) const
+		{
+			if(!selected(name)) return;
+			reseed();
+			body(1);
+			uint64_t ops = 0;
+			uint64_t batch = 1;
+			const auto start = Clock::now();
+			double seconds = 0.0;
+			while(seconds < options.min_time)
+			{
+				ops += body(batch);
+				batch *= 2;
+				seconds = since(start);
+			}
+			report({name, unit, ops, seconds});
+		}
+
+		// body() runs the whole workload and returns its op count
+		template<typename Body>
+		void macro(const std::string_view name, const std::string_view unit, Body body) const
+		{
+			if(!selected(name)) return;
+			reseed();
+			const auto start = Clock::now();
+			const uint64_t ops = body();
+			report({name, unit, ops, since(start)});
+		}
+	};
+
+	template<typename T>
+	bool parse(const std::string_view text, T& value)
+	{
+		if constexpr(std::is_floating_point_v<T>)
+		{
+			const std::string copy(text);
+			char* end = nullptr;
+			value = std::strtod(copy.c_str(), &end);
+			return !copy.empty() && *end == '\0';
+		}
+		else
+		{
+			const auto res = std::from_chars(text.data(), text.data() + text.size(), value);
+			return res.ec == std::errc() && res.ptr == text.data() + text.size();
+		}
+	}
+
+	bool parseArguments(const int argc, char** argv, Options& options)
+	{
+		if(argc % 2 == 0) return false;
+		for(int i = 1; i + 1 < argc; i += 2)
+		{
+			const std::string_view key = argv[i];
+			const std::string_view value = argv[i + 1];
+			bool valid = true;
+			if(key == "--min-time") valid = parse(value, options.min_time) && options.min_time > 0;
+			else if(key == "--threads") valid = parse(value, options.threads) && options.threads > 0;
+			else if(key == "--seed") valid = parse(value, options.seed);
+			else if(key == "--filter") options.filter = value;
+			else if(key == "--output") options.output = value;
+			else valid = false;
+			if(!valid) return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Suite suite;
+	if(!parseArguments(argc, argv, suite.options))
+	{
+		fmt::print(stderr, "Usage: bench [--min-time seconds] [--threads N] [--seed N] [--filter substring] [--output file.jsonl]\n");
+		return 1;
+	}
+	// The table is the output, not the engines' progress lines
+	NeuroEvolution::verbose = false;
+	suite.output = std::fopen(suite.options.output.c_str(), "w");
+	if(!suite.output)
+	{
+		fmt::print(stderr, "Cannot open {}\n", suite.options.output);
+		return 1;
+	}
+
+	// Micro benchmarks, single threaded
+	suite.micro("snake_step", "steps", [](const uint64_t n)
+	{
+		SnakeData sd;
+		std::uniform_int_distribution<uint32_t> pos_x(1, sd.width-2), pos_y(1, sd.height-2);
+		SnakeNN snake(pos_x(sd.rng), pos_y(sd.rng), NeuralNetwork{10, 3});
+		sd.reset(snake);
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			if(!sd.step(snake))
+			{
+				snake.respawn(pos_x(sd.rng), pos_y(sd.rng));
+				sd.reset(snake);
+			}
+		}
+		keep(snake.score);
+		return n;
+	});
+	suite.micro("snake_use_current_state", "decisions", [](const uint64_t n)
+	{
+		SnakeData sd;
+		SnakeNN snake(4, 4, NeuralNetwork{10, 3});
+		sd.reset(snake);
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			snake.useCurrentState(sd);
+			keep(snake.inputs);
+		}
+		return n;
+	});
+	suite.micro("snake_decision", "decisions", [](const uint64_t n)
+	{
+		SnakeData sd;
+		SnakeNN snake(4, 4, NeuralNetwork{10, 3});
+		sd.reset(snake);
+		snake.useCurrentState(sd);
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			const auto action = snake.doDecision();
+			keep(action);
+		}
+		return n;
+	});
+	suite.micro("feed_forward_dynamic", "calls", [](const uint64_t n)
+	{
+		const NeuralNetwork nn{10, 3};
+		const Eigen::VectorXf input = Eigen::VectorXf::LinSpaced(10, -1.0f, 1.0f);
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			const auto output = nn.feedForward(input);
+			keep(output);
+		}
+		return n;
+	});
+	suite.micro("feed_forward_fixed", "calls", [](const uint64_t n)
+	{
+		const NeuroEvolution::Policy nn;
+		const NeuroEvolution::Policy::Input input = NeuroEvolution::Policy::Input::LinSpaced(-1.0f, 1.0f);
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			const auto output = nn.feedForward(input);
+			keep(output);
+		}
+		return n;
+	});
+	suite.micro("mutate", "genomes", [](const uint64_t n)
+	{
+		Population population({10, 3}, 1);
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			NeuroEvolution::mutate(population.genome(0));
+		}
+		keep(population.genomes(0, 0));
+		return n;
+	});
+	suite.micro("cross", "genomes", [](const uint64_t n)
+	{
+		Population population({10, 3}, 3);
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			NeuroEvolution::cross(population.genome(0), population.genome(1), population.genome(2));
+		}
+		keep(population.genomes(2, 0));
+		return n;
+	});
+	suite.micro("tournament", "selections", [](const uint64_t n)
+	{
+		std::vector<double> fitnesses(400);
+		std::iota(std::begin(fitnesses), std::end(fitnesses), 0.0);
+		uint64_t sum = 0;
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			sum += NeuroEvolution::tournament(fitnesses, 10);
+		}
+		keep(sum);
+		return n;
+	});
+
+	// Macro benchmarks, use --threads workers
+	const uint32_t threads = suite.options.threads;
+	// Same episodes with int8 weights, see Quantization.h
+	const auto evaluatePopulation = [threads](const bool quantized)
+	{
+		SnakeData sd;
+		sd.quantized = quantized;
+		Evaluator evaluator(sd, 1000, threads);
+		Population population({10, 3}, 400);
+		std::vector<double> fitnesses;
+		for(uint32_t g = 0; g < 20; ++g)
+		{
+			evaluator.generation = g;
+			evaluator.evaluate(population, fitnesses);
+		}
+		return evaluator.steps();
+	};
+	suite.macro("evaluate_population", "steps", [&]() { return evaluatePopulation(false); });
+	suite.macro("evaluate_population_int8", "steps", [&]() { return evaluatePopulation(true); });
+	suite.macro("generation_generational", "generations", [threads]()
+	{
+		SnakeData sd;
+		NeuroEvolution::neuro_evolution(sd, 50, 400, 0.5, 0.8, 10, 1000, threads);
+		return 50;
+	});
+	suite.macro("generation_steady", "children", [threads]()
+	{
+		SnakeData sd;
+		NeuroEvolution::neuro_evolution_steady(sd, 20000, 400, 0.5, 0.8, 10, 1000, threads);
+		return 20000;
+	});
+	suite.macro("generation_async", "children", [threads]()
+	{
+		SnakeData sd;
+		NeuroEvolution::neuro_evolution_async(sd, 20000, 400, 0.5, 0.8, 10, 1000, threads);
+		return 20000;
+	});
+	suite.macro("generation_cross_entropy", "generations", [threads]()
+	{
+		SnakeData sd;
+		NeuroEvolution::cross_entropy(sd, 50, 100, 10, 0.1, 1000, threads);
+		return 50;
+	});
+	suite.macro("generation_evolution_strategies", "generations", [threads]()
+	{
+		SnakeData sd;
+		NeuroEvolution::evolution_strategies(sd, 50, 100, 0.1, 0.1, 1000, threads);
+		return 50;
+	});
+
+	std::fclose(suite.output);
+	return 0;
+}
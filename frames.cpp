@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <fmt/core.h>
+#include "NeuralNetwork.h"
+#include "Quantization.h"
+#include "Snake.h"
+#include "Checkpoint.h"
+#include "Trace.h"
+#include "Render.h"
+
+// Headless frame export: plays the best genomes of a checkpoint, or the best traces of a
+// trace file, side by side and writes every step as one tiled image.
+namespace
+{
+	struct Options
+	{
+		std::string input;
+		uint32_t games = 16;
+		render::Layout layout;
+		uint32_t sim_time = 1000;
+		// Frame limit, 0 runs until every game has ended
+		uint32_t frames = 0;
+		uint32_t episode = 0;
+		render::Format format = render::Format::PPM;
+		// Checkpoint games decide with int8 weights, as train --quantized evaluated them
+		bool quantized = false;
+		std::string output = "frames.ppm";
+	};
+
+	constexpr const char* usage =
+R"(Usage: frames FILE [--key value]...
+
+  FILE is a checkpoint or network written by train, or a trace file of train --traces.
+
+  --games K                   best genomes or traces shown (16)
+  --columns N                 tiles per image row, 0 for a square grid (0)
+  --scale N                   pixels per cell (4)
+  --gap N                     pixels between tiles (1)
+  --sim-time N                step limit of a game played from a checkpoint (1000)
+  --episode N                 episode whose start cells and rewards games play (0)
+  --frames N                  frames written, 0 until every game has ended (0)
+  --format NAME               ppm or raw rgb24 (ppm)
+  --weights NAME              float, or int8 for checkpoints of train --quantized (float)
+  --output PATH               file, - for stdout, or a directory ending in / for one
+                              PPM file per frame (frames.ppm)
+)";
+
+	template<typename T>
+	bool parse(const std::string_view text, T& value)
+	{
+		const auto res = std::from_chars(text.data(), text.data() + text.size(), value);
+		return res.ec == std::errc() && res.ptr == text.data() + text.size();
+	}
+
+	bool set(Options& options, const std::string_view key, const std::string_view value)
+	{
+		if(key == "games") return parse(value, options.games) && options.games > 0;
+		if(key == "columns") return parse(value, options.layout.columns);
+		if(key == "scale") return parse(value, options.layout.scale) && options.layout.scale > 0;
+		if(key == "gap") return parse(value, options.layout.gap);
+		if(key == "sim-time") return parse(value, options.sim_time);
+		if(key == "episode") return parse(value, options.episode);
+		if(key == "frames") return parse(value, options.frames);
+		if(key == "format")
+		{
+			if(value == "ppm") options.format = render::Format::PPM;
+			else if(value == "raw") options.format = render::Format::RAW;
+			else return false;
+			return true;
+		}
+		if(key == "weights")
+		{
+			if(value == "float") options.quantized = false;
+			else if(value == "int8") options.quantized = true;
+			else return false;
+			return true;
+		}
+		if(key == "output") { options.output = value; return true; }
+		return false;
+	}
+
+	bool parseArguments(const int argc, char** argv, Options& options)
+	{
+		if(argc < 2 || std::string_view(argv[1]).substr(0, 1) == "-") return false;
+		options.input = argv[1];
+		for(int i = 2; i + 1 < argc; i += 2)
+		{
+			const std::string_view key = argv[i];
+			if(key.substr(0, 2) != "--" || !set(options, key.substr(2), argv[i + 1]))
+			{
+				fmt::print(stderr, "Invalid option {} '{}'\n", key, argv[i + 1]);
+				return false;
+			}
+		}
+		return argc % 2 == 0;
+	}
+
+	// Game of one checkpoint genome, started like an evaluation episode
+	template<typename Network>
+	struct NetworkGame
+	{
+		SnakeData sd;
+		BasicSnakeNN<Network> s;
+		uint32_t steps = 0;
+		uint32_t sim_time;
+		bool alive = true;
+
+		NetworkGame(const SnakeData& problem, Network nn, const uint32_t sim_time, const uint32_t generation, const uint32_t genome, const uint32_t episode) :
+			sd(problem),
+			s(std::move(nn)),
+			sim_time(sim_time)
+		{
+			sd.rng = random::stream(generation, genome, episode, random::Purpose::SIMULATION);
+			std::uniform_int_distribution<uint32_t> pos_x(1, sd.width-2), pos_y(1, sd.height-2);
+			const auto x = pos_x(sd.rng);
+			s.respawn(x, pos_y(sd.rng));
+			sd.reset(s);
+		}
+
+		const SnakeData& board() const noexcept { return sd; }
+		const Snake& snake() const noexcept { return s; }
+		bool done() const noexcept { return !alive || steps == sim_time; }
+		bool next()
+		{
+			if(done()) return false;
+			alive = sd.step(s);
+			++steps;
+			return true;
+		}
+	};
+
+	// Steps every game that is still running and writes a frame per step, each tile only
+	// repaints the cells its step changed
+	template<typename Game>
+	int play(std::vector<Game>& games, const Options& options)
+	{
+		const auto& first = games.front().board();
+		render::Layout layout = options.layout;
+		layout.tiles = games.size();
+		render::Canvas canvas(first.width, first.height, layout);
+		render::Sink sink(options.output, options.format);
+		if(!sink.valid())
+		{
+			fmt::print(stderr, "Cannot write {}\n", options.output);
+			return 1;
+		}
+		fmt::print(stderr, "{} games in {}x{} frames\n", games.size(), canvas.width(), canvas.height());
+
+		const auto start = std::chrono::steady_clock::now();
+		for(uint32_t k = 0; k < games.size(); ++k)
+		{
+			canvas.draw(k, games[k].board(), games[k].snake());
+		}
+		bool ok = sink.write(canvas);
+		bool running = true;
+		while(ok && running && (!options.frames || sink.frames() < options.frames))
+		{
+			running = false;
+			for(uint32_t k = 0; k < games.size(); ++k)
+			{
+				if(games[k].next())
+				{
+					canvas.update(k, games[k].board(), games[k].snake());
+					running = true;
+				}
+			}
+			ok = !running || sink.write(canvas);
+		}
+		if(!ok)
+		{
+			fmt::print(stderr, "Cannot write {}\n", options.output);
+			return 1;
+		}
+		const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+		fmt::print(stderr, "{} frames in {:.3f} s, {:.0f} frames/s\n", sink.frames(), seconds.count(), sink.frames() / seconds.count());
+		return 0;
+	}
+
+	int renderCheckpoint(const checkpoint::Mapped& file, const Options& options)
+	{
+		const uint32_t genomes = file.header().genomes;
+		std::vector<uint32_t> order(genomes);
+		std::iota(std::begin(order), std::end(order), 0);
+		const double* fitnesses = file.fitnesses();
+		std::stable_sort(std::begin(order), std::end(order), [&](const uint32_t a, const uint32_t b)
+		{
+			return fitnesses[a] > fitnesses[b];
+		});
+		order.resize(std::min(genomes, options.games));
+
+		SnakeData problem;
+		problem.vision = file.topology().sizes.front() == Snake::vision_sensors;
+		// network turns a genome into the policy the games play
+		const auto start = [&](auto& games, const auto& network)
+		{
+			games.reserve(order.size());
+			for(const auto genome : order)
+			{
+				games.emplace_back(problem, network(file.network(genome)), options.sim_time, file.header().generation, genome, options.episode);
+			}
+			return play(games, options);
+		};
+		if(options.quantized)
+		{
+			std::vector<NetworkGame<QuantizedNetwork>> games;
+			return start(games, [&](const NeuralNetworkView& nn) { return QuantizedNetwork(nn, problem.inputScale()); });
+		}
+		std::vector<NetworkGame<NeuralNetworkView>> games;
+		return start(games, [](const NeuralNetworkView& nn) { return nn; });
+	}
+
+	int renderTraces(const std::vector<trace::Trace>& traces, const Options& options)
+	{
+		std::vector<uint32_t> order(traces.size());
+		std::iota(std::begin(order), std::end(order), 0);
+		std::stable_sort(std::begin(order), std::end(order), [&](const uint32_t a, const uint32_t b)
+		{
+			return traces[a].header.score > traces[b].header.score;
+		});
+		order.resize(std::min<size_t>(traces.size(), options.games));
+
+		std::vector<trace::Player> games;
+		games.reserve(order.size());
+		for(const auto t : order)
+		{
+			const auto& h = traces[t].header;
+			if(h.width != traces[order.front()].header.width || h.height != traces[order.front()].header.height)
+			{
+				fmt::print(stderr, "Trace {} has another board size\n", t);
+				return 1;
+			}
+			games.emplace_back(traces[t]);
+		}
+		return play(games, options);
+	}
+
+	bool isTrace(const std::string& path)
+	{
+		char head[sizeof(trace::magic)] = {};
+		std::FILE* file = std::fopen(path.c_str(), "rb");
+		if(!file) return false;
+		const bool read = std::fread(head, sizeof(head), 1, file) == 1;
+		std::fclose(file);
+		return read && std::memcmp(head, trace::magic, sizeof(head)) == 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if(!parseArguments(argc, argv, options))
+	{
+		fmt::print(stderr, "{}", usage);
+		return 1;
+	}
+	if(isTrace(options.input))
+	{
+		std::vector<trace::Trace> traces;
+		std::string error;
+		trace::read(options.input, traces, error);
+		if(!error.empty())
+		{
+			fmt::print(stderr, "{}\n", error);
+		}
+		if(traces.empty()) return 1;
+		return renderTraces(traces, options);
+	}
+	const checkpoint::Mapped file(options.input);
+	if(!file.valid())
+	{
+		fmt::print(stderr, "{}\n", file.error());
+		return 1;
+	}
+	random::run_seed = file.header().run_seed;
+	return renderCheckpoint(file, options);
+}
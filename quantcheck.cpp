@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+#include "NeuralNetwork.h"
+#include "Quantization.h"
+#include "Snake.h"
+#include "Checkpoint.h"
+
+// Checks int8 policies against their float originals: plays the best genomes of a
+// checkpoint with the float network, counts the decisions the quantized one would take
+// differently on the same inputs, compares the scores of both and times single decisions.
+namespace
+{
+	struct Options
+	{
+		std::string input;
+		uint32_t games = 16;
+		uint32_t episodes = 10;
+		uint32_t sim_time = 1000;
+	};
+
+	constexpr const char* usage =
+R"(Usage: quantcheck FILE [--key value]...
+
+  FILE is a checkpoint or network written by train.
+
+  --games K                   best genomes checked (16)
+  --episodes N                episodes per genome (10)
+  --sim-time N                step limit of an episode (1000)
+)";
+
+	template<typename T>
+	bool parse(const std::string_view text, T& value)
+	{
+		const auto res = std::from_chars(text.data(), text.data() + text.size(), value);
+		return res.ec == std::errc() && res.ptr == text.data() + text.size();
+	}
+
+	bool set(Options& options, const std::string_view key, const std::string_view value)
+	{
+		if(key == "games") return parse(value, options.games) && options.games > 0;
+		if(key == "episodes") return parse(value, options.episodes) && options.episodes > 0;
+		if(key == "sim-time") return parse(value, options.sim_time);
+		return false;
+	}
+
+	bool parseArguments(const int argc, char** argv, Options& options)
+	{
+		if(argc < 2 || std::string_view(argv[1]).substr(0, 1) == "-") return false;
+		options.input = argv[1];
+		for(int i = 2; i + 1 < argc; i += 2)
+		{
+			const std::string_view key = argv[i];
+			if(key.substr(0, 2) != "--" || !set(options, key.substr(2), argv[i + 1]))
+			{
+				fmt::print(stderr, "Invalid option {} '{}'\n", key, argv[i + 1]);
+				return false;
+			}
+		}
+		return argc % 2 == 0;
+	}
+
+	// Snake of policy nn on problem, started like an evaluation episode
+	template<typename Network>
+	BasicSnakeNN<Network> start(SnakeData& sd, const Network& nn, const uint32_t generation, const uint32_t genome, const uint32_t episode)
+	{
+		sd.rng = random::stream(generation, genome, episode, random::Purpose::SIMULATION);
+		std::uniform_int_distribution<uint32_t> pos_x(1, sd.width-2), pos_y(1, sd.height-2);
+		const auto x = pos_x(sd.rng);
+		BasicSnakeNN<Network> s(x, pos_y(sd.rng), nn);
+		sd.reset(s);
+		return s;
+	}
+
+	// Decisions per second of network over the recorded inputs
+	template<typename Network>
+	double rate(const Network& nn, const std::vector<Eigen::VectorXf>& inputs)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		uint32_t actions = 0;
+		for(const auto& input : inputs)
+		{
+			actions += nn.decide(input);
+		}
+		asm volatile("" : : "r"(actions));
+		const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+		return inputs.size() / seconds.count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if(!parseArguments(argc, argv, options))
+	{
+		fmt::print(stderr, "{}", usage);
+		return 1;
+	}
+	const checkpoint::Mapped file(options.input);
+	if(!file.valid())
+	{
+		fmt::print(stderr, "{}\n", file.error());
+		return 1;
+	}
+	random::run_seed = file.header().run_seed;
+	const uint32_t generation = file.header().generation;
+
+	const uint32_t genomes = file.header().genomes;
+	std::vector<uint32_t> order(genomes);
+	std::iota(std::begin(order), std::end(order), 0);
+	const double* fitnesses = file.fitnesses();
+	std::stable_sort(std::begin(order), std::end(order), [&](const uint32_t a, const uint32_t b)
+	{
+		return fitnesses[a] > fitnesses[b];
+	});
+	order.resize(std::min(genomes, options.games));
+
+	SnakeData problem;
+	problem.vision = file.topology().sizes.front() == Snake::vision_sensors;
+	// Inputs kept for timing, enough for a stable rate without holding whole runs
+	constexpr size_t recorded = 1 << 16;
+	std::vector<Eigen::VectorXf> inputs;
+	uint64_t decisions = 0, differing = 0;
+	double float_rate = 0.0, quantized_rate = 0.0;
+	fmt::print("genome  float score  int8 score  differing decisions\n");
+	for(const auto genome : order)
+	{
+		const NeuralNetworkView nn = file.network(genome);
+		const QuantizedNetwork qnn(nn, problem.inputScale());
+		uint64_t float_score = 0, quantized_score = 0, genome_decisions = 0, genome_differing = 0;
+		inputs.clear();
+		for(uint32_t episode = 0; episode < options.episodes; ++episode)
+		{
+			// The float policy drives, the quantized one only decides on the same inputs
+			SnakeData sd = problem;
+			auto s = start(sd, nn, generation, genome, episode);
+			bool alive = true;
+			for(uint32_t t = 0; t < options.sim_time && alive; ++t)
+			{
+				s.useCurrentState(sd);
+				const auto action = s.nn.decide(s.inputs);
+				genome_differing += action != qnn.decide(s.inputs);
+				++genome_decisions;
+				if(inputs.size() < recorded)
+				{
+					inputs.push_back(s.inputs);
+				}
+				s.advance(static_cast<Snake::Actions>(action));
+				alive = sd.resolve(s);
+			}
+			float_score += s.score;
+
+			SnakeData qsd = problem;
+			auto q = start(qsd, qnn, generation, genome, episode);
+			for(uint32_t t = 0; t < options.sim_time && qsd.step(q); ++t);
+			quantized_score += q.score;
+		}
+		fmt::print("{:6}  {:11.2f}  {:10.2f}  {} / {} ({:.3f}%)\n", genome,
+			double(float_score) / options.episodes, double(quantized_score) / options.episodes,
+			genome_differing, genome_decisions, 100.0 * genome_differing / std::max<uint64_t>(genome_decisions, 1));
+		decisions += genome_decisions;
+		differing += genome_differing;
+		float_rate += rate(nn, inputs);
+		quantized_rate += rate(qnn, inputs);
+	}
+	fmt::print("Differing decisions: {} / {} ({:.3f}%)\n", differing, decisions, 100.0 * differing / std::max<uint64_t>(decisions, 1));
+	// Single decisions; batch evaluations with --quantized are measured by bench
+	fmt::print("Decisions/s float: {:.0f}, int8: {:.0f}\n", float_rate / order.size(), quantized_rate / order.size());
+	return 0;
+}
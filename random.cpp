@@ -1,3 +1,49 @@
 #include "random.h"
 
-std::mt19937 random::random_generator{std::random_device()()};
+thread_local random::Philox random::random_generator{(static_cast<uint64_t>(std::random_device()()) << 32) | std::random_device()()};
+thread_local random::VectorGenerator random::vector_generator{(static_cast<uint64_t>(random_generator()) << 32) | random_generator()};
+
+uint64_t random::run_seed = (static_cast<uint64_t>(std::random_device()()) << 32) | std::random_device()();
+
+random::Philox::Philox(const uint64_t key, const uint32_t stream1, const uint32_t stream2, const uint32_t stream3) noexcept :
+	key{static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32)},
+	counter{0, stream1, stream2, stream3} {}
+
+random::VectorGenerator::VectorGenerator(const uint64_t seed)
+{
+	this->seed(seed);
+}
+
+void random::VectorGenerator::seed(uint64_t seed) noexcept
+{
+	// splitmix64 expands the seed so that no lane starts from an all zero state
+	for(uint32_t l = 0; l < lanes; ++l)
+	{
+		for(uint32_t w = 0; w < 4; w += 2)
+		{
+			uint64_t z = (seed += 0x9e3779b97f4a7c15);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+			z ^= z >> 31;
+			state[w][l] = static_cast<uint32_t>(z);
+			state[w + 1][l] = static_cast<uint32_t>(z >> 32);
+		}
+	}
+}
+
+void random::seed(const uint64_t seed, const uint32_t stream)
+{
+	random_generator = Philox(seed, 0, stream, static_cast<uint32_t>(Purpose::THREAD));
+	vector_generator.seed((static_cast<uint64_t>(random_generator()) << 32) | random_generator());
+}
+
+random::Philox random::stream(const uint32_t generation, const uint32_t genome, const uint32_t episode, const Purpose purpose) noexcept
+{
+	return Philox(run_seed, generation, genome, (episode << 8) | static_cast<uint32_t>(purpose));
+}
+
+void random::use(const uint32_t generation, const uint32_t genome, const uint32_t episode, const Purpose purpose) noexcept
+{
+	random_generator = stream(generation, genome, episode, purpose);
+	vector_generator.seed((static_cast<uint64_t>(random_generator()) << 32) | random_generator());
+}
@@ -1,11 +1,166 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <random>
 
 struct random
 {
-	static std::mt19937 random_generator;
+	// Philox4x32-10 counter based generator. Output block n is a pure function of (key, n, stream),
+	// so any stream can be created on any thread in any order and still produce the same values.
+	struct Philox
+	{
+		using result_type = uint32_t;
+
+		std::array<uint32_t, 2> key;
+		// counter[0] - block index, counter[1..3] - stream identifier
+		std::array<uint32_t, 4> counter;
+		std::array<uint32_t, 4> block{};
+		uint32_t used = 4;
+
+		explicit Philox(const uint64_t key = 0, const uint32_t stream1 = 0, const uint32_t stream2 = 0, const uint32_t stream3 = 0) noexcept;
+
+		static constexpr result_type min() noexcept { return 0; }
+		static constexpr result_type max() noexcept { return UINT32_MAX; }
+		result_type operator()() noexcept;
+		static std::array<uint32_t, 4> generate(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) noexcept;
+	};
+
+	// What a stream is used for, so e.g. simulation and variation of one genome never share values
+	enum class Purpose : uint32_t
+	{
+		THREAD, INITIALIZATION, SIMULATION, VARIATION, MIGRATION, NOISE, DECISION
+	};
+
+	// Eight interleaved xoshiro128+ streams stored lane by lane. Every update is the same
+	// operation on all lanes, so the loops compile to plain SIMD and random numbers come
+	// in blocks instead of one distribution call per value.
+	struct VectorGenerator
+	{
+		static constexpr uint32_t lanes = 8;
+
+		alignas(32) uint32_t state[4][lanes];
+
+		explicit VectorGenerator(const uint64_t seed);
+		void seed(uint64_t seed) noexcept;
+		void next(uint32_t (&out)[lanes]) noexcept;
+		// data[i] += uniform(low, high)
+		void addUniform(float* data, const size_t count, const float low, const float high) noexcept;
+		// res[i] = fair coin ? a[i] : b[i]; res may alias a or b
+		void blend(const float* a, const float* b, float* res, const size_t count) noexcept;
+	};
+
+	// Every thread owns its own stream, so workers never share generator state
+	static thread_local Philox random_generator;
+	static thread_local VectorGenerator vector_generator;
+	// Key of all reproducible streams, the only state needed to replay a run
+	static uint64_t run_seed;
+
+	static void seed(const uint64_t seed, const uint32_t stream = 0);
+	// Reproducible stream of run_seed; episode has to fit in 24 bits
+	static Philox stream(const uint32_t generation, const uint32_t genome, const uint32_t episode, const Purpose purpose) noexcept;
+	// Points both generators of the calling thread at stream(generation, genome, episode, purpose)
+	static void use(const uint32_t generation, const uint32_t genome, const uint32_t episode, const Purpose purpose) noexcept;
 };
 
+inline random::Philox::result_type random::Philox::operator()() noexcept
+{
+	if(used == 4)
+	{
+		block = generate(counter, key);
+		++counter[0];
+		used = 0;
+	}
+	return block[used++];
+}
+
+inline std::array<uint32_t, 4> random::Philox::generate(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) noexcept
+{
+	for(uint32_t round = 0; round < 10; ++round)
+	{
+		const uint64_t product0 = static_cast<uint64_t>(0xD2511F53) * counter[0];
+		const uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57) * counter[2];
+		counter = {
+			static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+			static_cast<uint32_t>(product1),
+			static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+			static_cast<uint32_t>(product0)};
+		key[0] += 0x9E3779B9;
+		key[1] += 0xBB67AE85;
+	}
+	return counter;
+}
+
+inline void random::VectorGenerator::next(uint32_t (&out)[lanes]) noexcept
+{
+	for(uint32_t l = 0; l < lanes; ++l)
+	{
+		auto& s0 = state[0][l];
+		auto& s1 = state[1][l];
+		auto& s2 = state[2][l];
+		auto& s3 = state[3][l];
+		out[l] = s0 + s3;
+		const uint32_t t = s1 << 9;
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = (s3 << 11) | (s3 >> 21);
+	}
+}
+
+inline void random::VectorGenerator::addUniform(float* data, const size_t count, const float low, const float high) noexcept
+{
+	// Top 24 bits give a uniform float in [0, 1)
+	const float scale = (high - low) * 0x1.0p-24f;
+	uint32_t bits[lanes];
+	size_t i = 0;
+	for(; i + lanes <= count; i += lanes)
+	{
+		next(bits);
+		for(uint32_t l = 0; l < lanes; ++l)
+		{
+			data[i + l] += low + static_cast<float>(bits[l] >> 8) * scale;
+		}
+	}
+	if(i == count) return;
+	next(bits);
+	for(uint32_t l = 0; i + l < count; ++l)
+	{
+		data[i + l] += low + static_cast<float>(bits[l] >> 8) * scale;
+	}
+}
+
+inline void random::VectorGenerator::blend(const float* a, const float* b, float* res, const size_t count) noexcept
+{
+	uint32_t bits[lanes];
+	float block[lanes];
+	size_t i = 0;
+	for(; i + lanes <= count; i += lanes)
+	{
+		next(bits);
+		// Both parents are loaded unconditionally and blended into a local block first,
+		// so neither branches nor res aliasing a parent block vectorisation
+		for(uint32_t l = 0; l < lanes; ++l)
+		{
+			const float x = a[i + l];
+			const float y = b[i + l];
+			block[l] = (bits[l] >> 31) ? x : y;
+		}
+		for(uint32_t l = 0; l < lanes; ++l)
+		{
+			res[i + l] = block[l];
+		}
+	}
+	if(i == count) return;
+	next(bits);
+	for(uint32_t l = 0; i + l < count; ++l)
+	{
+		res[i + l] = (bits[l] >> 31) ? a[i + l] : b[i + l];
+	}
+}
+
 #endif // RANDOM_H
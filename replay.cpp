@@ -0,0 +1,89 @@
+#include <charconv>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+#include "Snake.h"
+#include "Trace.h"
+
+// Lists the traces of a file written by train --traces, or prints every frame of one of them
+// as text. Frames are rebuilt from the recorded actions, no network is needed.
+namespace
+{
+	constexpr const char* usage =
+R"(Usage: replay FILE [N]
+
+  Without N lists the traces of FILE, with N prints the frames of trace N and checks
+  that the replayed score matches the recorded one.
+)";
+
+	void printFrame(const trace::Player& player)
+	{
+		constexpr char cells[] = {' ', '#', '*', 'o', '@'};
+		const Eigen::ArrayXXi frame = player.frame();
+		std::string text;
+		for(Eigen::Index y = frame.cols() - 1; y >= 0; --y)
+		{
+			for(Eigen::Index x = 0; x < frame.rows(); ++x)
+			{
+				text += cells[frame(x, y)];
+			}
+			text += '\n';
+		}
+		fmt::print("step {} score {}\n{}", player.step(), player.snake().score, text);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 2 || argc > 3)
+	{
+		fmt::print(stderr, "{}", usage);
+		return 1;
+	}
+	std::vector<trace::Trace> traces;
+	std::string error;
+	const bool complete = trace::read(argv[1], traces, error);
+	if(!error.empty())
+	{
+		fmt::print(stderr, "{}\n", error);
+	}
+	if(argc == 2)
+	{
+		fmt::print("{:>6} {:>10} {:>8} {:>6} {:>6} {:>6}\n", "trace", "generation", "genome", "steps", "score", "end");
+		for(size_t t = 0; t < traces.size(); ++t)
+		{
+			const auto& h = traces[t].header;
+			fmt::print("{:>6} {:>10} {:>8} {:>6} {:>6} {:>6}\n", t, h.generation, h.genome, h.steps, h.score, h.timed_out ? "time" : "crash");
+		}
+		return complete ? 0 : 1;
+	}
+
+	const std::string_view text = argv[2];
+	size_t index = 0;
+	const auto res = std::from_chars(text.data(), text.data() + text.size(), index);
+	if(res.ec != std::errc() || res.ptr != text.data() + text.size())
+	{
+		fmt::print(stderr, "Invalid trace number '{}'\n{}", text, usage);
+		return 1;
+	}
+	if(index >= traces.size())
+	{
+		fmt::print(stderr, "{} has {} traces\n", argv[1], traces.size());
+		return 1;
+	}
+	trace::Player player(traces[index]);
+	printFrame(player);
+	while(player.next())
+	{
+		printFrame(player);
+	}
+	const auto& h = traces[index].header;
+	if(player.snake().score != h.score)
+	{
+		fmt::print(stderr, "Replayed score {} differs from the recorded {}\n", player.snake().score, h.score);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,466 @@
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <fmt/core.h>
+#include "NeuralNetwork.h"
+#include "Snake.h"
+#include "NeuroEvolution.h"
+#include "Checkpoint.h"
+#include "Telemetry.h"
+#include "Trace.h"
+#include "Migration.h"
+
+// Headless training: evolves a policy with the selected engine and writes the best network
+// to a single genome checkpoint, which the viewer loads.
+namespace
+{
+	struct Options
+	{
+		std::string algorithm = "steady";
+		uint32_t population = 400;
+		uint32_t iterations = 100000;
+		uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+		uint64_t seed = random::run_seed;
+		// --seed was given, islands in separate processes need the same one
+		bool seeded = false;
+		uint32_t sim_time = 1000;
+		bool vision = false;
+		bool quantized = false;
+		float mutation = 0.5;
+		float crossover = 0.8;
+		uint32_t tournament = 10;
+		uint32_t elite = 10;
+		double learn_rate = 0.1;
+		float sigma = 0.1;
+		Racing racing;
+		Caching caching;
+		Checkpointing checkpointing;
+		Migration migration;
+		// Island run by this process, all islands run as threads when negative
+		int64_t island = -1;
+		std::string mailbox = "/snake-islands";
+		std::string telemetry;
+		std::string traces;
+		uint32_t trace_interval = 1;
+		std::string output = "snake.nn";
+	};
+
+	constexpr const char* usage =
+R"(Usage: train [--key value | --key=value | --config file]...
+
+  --algorithm NAME            generational, steady, async, cross-entropy or es (steady)
+  --population N              genomes in the population, even for es (400)
+  --iterations N              generations, or children for steady and async (100000)
+  --threads N                 simulation workers (all cores)
+  --seed N                    run seed, random when omitted
+  --sim-time N                step limit of an episode (1000)
+  --vision                    add 8 long range rays to the sensors (off)
+  --quantized                 evaluate with int8 weights, see quantcheck (off)
+  --mutation P                mutation probability (0.5)
+  --crossover P               crossover probability (0.8)
+  --tournament N              tournament size (10)
+  --elite N                   cross entropy elite size (10)
+  --learn-rate X              cross entropy and es learning rate (0.1)
+  --sigma X                   es noise standard deviation (0.1)
+  --episodes N                episodes per racing round (1)
+  --rounds N                  successive halving rounds (0)
+  --cache N                   fitness cache entries, 0 disables it (0)
+  --cache-episodes N          episodes after which cached genomes are not replayed (1)
+  --checkpoint PATH           checkpoint file
+  --checkpoint-interval N     generations between checkpoints, 0 never saves (0)
+  --resume                    continue from the checkpoint when it exists
+  --islands N                 populations evolved side by side, generational only (1)
+  --migration-interval N      generations between migrations (10)
+  --migrants N                genomes sent and replaced per migration, below the
+                              population (2)
+  --migration-topology NAME   ring, full or random (ring)
+  --island K                  run only island K in this process, the others run elsewhere;
+                              needs the same --seed in every process
+  --mailbox NAME              shared memory of the islands of --island (/snake-islands)
+  --telemetry PATH            JSON lines record per generation with phase timings
+  --traces PATH               replay trace of the best episode per generation, see replay
+  --trace-interval N          generations between traces (1)
+  --output PATH               trained network (snake.nn)
+  --config PATH               file of "key = value" lines with the keys above
+)";
+
+	template<typename T>
+	bool parse(const std::string_view text, T& value)
+	{
+		if constexpr(std::is_floating_point_v<T>)
+		{
+			const std::string copy(text);
+			char* end = nullptr;
+			value = std::strtod(copy.c_str(), &end);
+			return !copy.empty() && *end == '\0';
+		}
+		else
+		{
+			const auto res = std::from_chars(text.data(), text.data() + text.size(), value);
+			return res.ec == std::errc() && res.ptr == text.data() + text.size();
+		}
+	}
+
+	// Switches take no value on the command line, config files may spell them out
+	bool flag(const std::string_view value, bool& res)
+	{
+		res = value.empty() || value == "true" || value == "1";
+		return true;
+	}
+
+	bool readConfig(const std::string& path, Options& options);
+
+	// Applies one option, false for unknown keys and malformed values
+	bool set(Options& options, const std::string_view key, const std::string_view value)
+	{
+		if(key == "algorithm") { options.algorithm = value; return true; }
+		if(key == "population") return parse(value, options.population) && options.population > 0;
+		if(key == "iterations") return parse(value, options.iterations) && options.iterations > 0;
+		if(key == "threads") return parse(value, options.threads) && options.threads > 0;
+		if(key == "seed") { options.seeded = true; return parse(value, options.seed); }
+		if(key == "sim-time") return parse(value, options.sim_time) && options.sim_time > 0;
+		if(key == "vision") return flag(value, options.vision);
+		if(key == "quantized") return flag(value, options.quantized);
+		if(key == "mutation") return parse(value, options.mutation);
+		if(key == "crossover") return parse(value, options.crossover);
+		if(key == "tournament") return parse(value, options.tournament) && options.tournament > 0;
+		if(key == "elite") return parse(value, options.elite) && options.elite > 0;
+		if(key == "learn-rate") return parse(value, options.learn_rate);
+		if(key == "sigma") return parse(value, options.sigma) && options.sigma > 0;
+		if(key == "episodes") return parse(value, options.racing.episodes) && options.racing.episodes > 0;
+		if(key == "rounds") return parse(value, options.racing.rounds);
+		if(key == "cache") return parse(value, options.caching.capacity);
+		if(key == "cache-episodes") return parse(value, options.caching.episodes);
+		if(key == "checkpoint") { options.checkpointing.path = value; return true; }
+		if(key == "checkpoint-interval") return parse(value, options.checkpointing.interval);
+		if(key == "resume") return flag(value, options.checkpointing.resume);
+		if(key == "islands") return parse(value, options.migration.islands) && options.migration.islands > 0;
+		if(key == "migration-interval") return parse(value, options.migration.interval);
+		if(key == "migrants") return parse(value, options.migration.migrants) && options.migration.migrants > 0;
+		if(key == "migration-topology")
+		{
+			if(value == "ring") options.migration.topology = MigrationTopology::RING;
+			else if(value == "full") options.migration.topology = MigrationTopology::FULL;
+			else if(value == "random") options.migration.topology = MigrationTopology::RANDOM;
+			else return false;
+			return true;
+		}
+		if(key == "island") return parse(value, options.island) && options.island >= 0;
+		if(key == "mailbox") { options.mailbox = value; return value.size() > 1 && value.front() == '/'; }
+		if(key == "telemetry") { options.telemetry = value; return true; }
+		if(key == "traces") { options.traces = value; return true; }
+		if(key == "trace-interval") return parse(value, options.trace_interval);
+		if(key == "output") { options.output = value; return true; }
+		if(key == "config") return readConfig(std::string(value), options);
+		return false;
+	}
+
+	std::string_view trim(std::string_view text)
+	{
+		const auto first = text.find_first_not_of(" \t\r");
+		if(first == std::string_view::npos) return {};
+		return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+	}
+
+	bool readConfig(const std::string& path, Options& options)
+	{
+		std::ifstream file(path);
+		if(!file.is_open())
+		{
+			fmt::print(stderr, "Cannot open config {}\n", path);
+			return false;
+		}
+		std::string line;
+		for(uint32_t number = 1; std::getline(file, line); ++number)
+		{
+			const auto text = trim(std::string_view(line).substr(0, line.find('#')));
+			if(text.empty()) continue;
+			const auto equals = text.find('=');
+			const auto key = trim(text.substr(0, equals));
+			const auto value = equals == std::string_view::npos ? std::string_view() : trim(text.substr(equals + 1));
+			if(!set(options, key, value))
+			{
+				fmt::print(stderr, "{}:{}: invalid option '{}'\n", path, number, text);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool parseArguments(const int argc, char** argv, Options& options)
+	{
+		for(int i = 1; i < argc; ++i)
+		{
+			std::string_view arg = argv[i];
+			if(arg == "-h" || arg == "--help") return false;
+			if(arg.substr(0, 2) != "--")
+			{
+				fmt::print(stderr, "Unexpected argument '{}'\n", arg);
+				return false;
+			}
+			arg.remove_prefix(2);
+			std::string_view key = arg, value;
+			if(const auto equals = arg.find('='); equals != std::string_view::npos)
+			{
+				key = arg.substr(0, equals);
+				value = arg.substr(equals + 1);
+			}
+			else if(key != "resume" && key != "vision" && key != "quantized")
+			{
+				if(i + 1 == argc)
+				{
+					fmt::print(stderr, "Missing value of --{}\n", key);
+					return false;
+				}
+				value = argv[++i];
+			}
+			if(!set(options, key, value))
+			{
+				fmt::print(stderr, "Invalid option --{} '{}'\n", key, value);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Checks the options that depend on each other, once all of them are set
+	bool validate(const Options& options)
+	{
+		const bool tournaments = options.algorithm == "generational" || options.algorithm == "steady" || options.algorithm == "async";
+		if(tournaments && options.population < options.tournament)
+		{
+			fmt::print(stderr, "--tournament {} needs a population of at least {}, not {}\n", options.tournament, options.tournament, options.population);
+			return false;
+		}
+		if(options.checkpointing.interval > 0 && options.checkpointing.path.empty())
+		{
+			fmt::print(stderr, "--checkpoint-interval needs --checkpoint\n");
+			return false;
+		}
+		return true;
+	}
+
+	// Stores nn as a one genome checkpoint together with its mean score
+	bool saveNetwork(const Options& options, const checkpoint::Engine engine, const NeuralNetwork& nn, const double score)
+	{
+		std::vector<uint32_t> sizes{nn.inputsCount()};
+		for(const auto& layer : nn.weights)
+		{
+			sizes.push_back(layer.cols());
+		}
+		Population best(Topology(std::begin(sizes), std::end(sizes)), 1, false);
+		for(uint32_t l = 0; l < nn.weights.size(); ++l)
+		{
+			const auto& layer = nn.weights[l];
+			best.genome(0).segment(best.topology.offsets[l], layer.size()) = Eigen::Map<const Eigen::RowVectorXf>(layer.data(), layer.size());
+		}
+		return checkpoint::save(options.output, engine, options.iterations, best, {score});
+	}
+
+	// Islands running in one process keep their checkpoints, telemetry and traces in separate files
+	std::string islandPath(const Options& options, const std::string& path, const uint32_t island)
+	{
+		if(path.empty() || options.island >= 0 || options.migration.islands < 2) return path;
+		return fmt::format("{}.{}", path, island);
+	}
+
+	// Evolves the islands of this process with the generational engine, one thread per
+	// island sharing the workers; results gets the best network of every island
+	bool evolveIslands(const Options& options, const SnakeData& sd, std::vector<NeuralNetwork>& results)
+	{
+		const Topology topology = NeuroEvolution::topology(sd);
+		const uint32_t first = options.island >= 0 ? options.island : 0;
+		const uint32_t count = options.island >= 0 ? 1 : options.migration.islands;
+		if(first >= options.migration.islands)
+		{
+			fmt::print(stderr, "Island {} of {} islands\n", first, options.migration.islands);
+			return false;
+		}
+		// Migrants replace the worst residents, some of the population has to stay
+		if(options.migration.migrants >= options.population)
+		{
+			fmt::print(stderr, "--migrants {} needs a population above it, not {}\n", options.migration.migrants, options.population);
+			return false;
+		}
+		// Islands only take migrants of their own run, which a random seed per process breaks
+		if(options.island >= 0 && !options.seeded)
+		{
+			fmt::print(stderr, "--island needs a --seed shared by all islands\n");
+			return false;
+		}
+		Mailbox mailbox(options.island >= 0 ? options.mailbox : "", options.migration, Population(topology, 0, false).genomes.cols(), options.seed);
+		if(!mailbox.valid())
+		{
+			fmt::print(stderr, "Cannot open mailbox: {}\n", mailbox.error());
+			return false;
+		}
+		std::vector<std::unique_ptr<Telemetry>> telemetry(count);
+		for(uint32_t k = 0; k < count && !options.telemetry.empty(); ++k)
+		{
+			telemetry[k] = std::make_unique<Telemetry>(islandPath(options, options.telemetry, k));
+			if(!telemetry[k]->valid())
+			{
+				fmt::print(stderr, "Cannot write {}\n", islandPath(options, options.telemetry, k));
+				return false;
+			}
+		}
+		std::vector<std::unique_ptr<trace::Writer>> traces(count);
+		for(uint32_t k = 0; k < count && !options.traces.empty(); ++k)
+		{
+			traces[k] = std::make_unique<trace::Writer>(islandPath(options, options.traces, k), options.trace_interval);
+			if(!traces[k]->valid())
+			{
+				fmt::print(stderr, "Cannot write {}\n", islandPath(options, options.traces, k));
+				return false;
+			}
+		}
+		const uint32_t threads = std::max(1u, options.threads / count);
+		results.resize(count);
+		std::vector<std::thread> islands;
+		for(uint32_t k = 0; k < count; ++k)
+		{
+			islands.emplace_back([&, k]()
+			{
+				Island island(mailbox, first + k, options.migration, topology);
+				Checkpointing checkpointing = options.checkpointing;
+				checkpointing.path = islandPath(options, checkpointing.path, k);
+				SnakeData problem = sd;
+				results[k] = NeuroEvolution::neuro_evolution(problem, options.iterations, options.population, options.mutation, options.crossover, options.tournament, options.sim_time, threads, options.racing, options.caching, checkpointing, telemetry[k].get(), traces[k].get(), &island);
+				fmt::print("Island {} took {} migrants\n", first + k, island.immigrants());
+			});
+		}
+		for(auto& island : islands)
+		{
+			island.join();
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if(!parseArguments(argc, argv, options))
+	{
+		fmt::print(stderr, "{}", usage);
+		return 1;
+	}
+	if(!validate(options)) return 1;
+	// A resumed run continues on the streams of its checkpoint. The seed is settled here,
+	// before the engines and island threads that read it start.
+	if(options.checkpointing.resume)
+	{
+		const checkpoint::Mapped file(islandPath(options, options.checkpointing.path, 0));
+		if(file.valid())
+		{
+			options.seed = file.header().run_seed;
+			options.seeded = true;
+		}
+	}
+	random::run_seed = options.seed;
+	fmt::print("Algorithm: {}, population: {}, iterations: {}, threads: {}, seed: {}\n",
+		options.algorithm, options.population, options.iterations, options.threads, options.seed);
+
+	SnakeData sd;
+	sd.vision = options.vision;
+	sd.quantized = options.quantized;
+	std::vector<NeuralNetwork> results;
+	checkpoint::Engine engine = checkpoint::Engine::GENERATIONAL;
+	if(options.migration.islands > 1 || options.island >= 0)
+	{
+		if(options.algorithm != "generational")
+		{
+			fmt::print(stderr, "Islands run the generational engine, use --algorithm generational\n");
+			return 1;
+		}
+		if(!evolveIslands(options, sd, results)) return 1;
+	}
+	else
+	{
+		std::optional<Telemetry> telemetry;
+		if(!options.telemetry.empty())
+		{
+			telemetry.emplace(options.telemetry);
+			if(!telemetry->valid())
+			{
+				fmt::print(stderr, "Cannot write {}\n", options.telemetry);
+				return 1;
+			}
+		}
+		Telemetry* sink = telemetry ? &*telemetry : nullptr;
+		std::optional<trace::Writer> traces;
+		if(!options.traces.empty())
+		{
+			traces.emplace(options.traces, options.trace_interval);
+			if(!traces->valid())
+			{
+				fmt::print(stderr, "Cannot write {}\n", options.traces);
+				return 1;
+			}
+		}
+		trace::Writer* recorder = traces ? &*traces : nullptr;
+
+		NeuralNetwork nn;
+		if(options.algorithm == "generational")
+		{
+			nn = NeuroEvolution::neuro_evolution(sd, options.iterations, options.population, options.mutation, options.crossover, options.tournament, options.sim_time, options.threads, options.racing, options.caching, options.checkpointing, sink, recorder);
+		}
+		else if(options.algorithm == "steady")
+		{
+			engine = checkpoint::Engine::STEADY;
+			nn = NeuroEvolution::neuro_evolution_steady(sd, options.iterations, options.population, options.mutation, options.crossover, options.tournament, options.sim_time, options.threads, options.racing, options.caching, options.checkpointing, sink, recorder);
+		}
+		else if(options.algorithm == "async")
+		{
+			engine = checkpoint::Engine::ASYNC;
+			nn = NeuroEvolution::neuro_evolution_async(sd, options.iterations, options.population, options.mutation, options.crossover, options.tournament, options.sim_time, options.threads, options.checkpointing, sink, recorder);
+		}
+		else if(options.algorithm == "cross-entropy")
+		{
+			engine = checkpoint::Engine::CROSS_ENTROPY;
+			nn = NeuroEvolution::cross_entropy(sd, options.iterations, options.population, options.elite, options.learn_rate, options.sim_time, options.threads, options.racing, options.caching, options.checkpointing, sink, recorder);
+		}
+		else if(options.algorithm == "es")
+		{
+			// Every sample is played with its mirror
+			if(options.population < 2 || options.population % 2)
+			{
+				fmt::print(stderr, "--algorithm es needs an even population, not {}\n", options.population);
+				return 1;
+			}
+			engine = checkpoint::Engine::EVOLUTION_STRATEGIES;
+			nn = NeuroEvolution::evolution_strategies(sd, options.iterations, options.population, options.sigma, options.learn_rate, options.sim_time, options.threads, options.racing, options.caching, options.checkpointing, sink, recorder);
+		}
+		else
+		{
+			fmt::print(stderr, "Unknown algorithm '{}'\n{}", options.algorithm, usage);
+			return 1;
+		}
+		results.push_back(nn);
+	}
+
+	// Score the results on fresh episodes, the selected fitness is biased upwards
+	std::vector<double> scores;
+	Evaluator evaluator(sd, options.sim_time, options.threads, Racing{16, 0});
+	evaluator.generation = options.iterations + 1;
+	evaluator.evaluate(results, scores);
+	const uint32_t best = std::max_element(std::begin(scores), std::end(scores)) - std::begin(scores);
+	if(results.size() > 1)
+	{
+		fmt::print("Best island: {}\n", best);
+	}
+	fmt::print("Mean score over 16 episodes: {}\n", scores[best]);
+
+	if(!saveNetwork(options, engine, results[best], scores[best]))
+	{
+		fmt::print(stderr, "Cannot write {}\n", options.output);
+		return 1;
+	}
+	fmt::print("Network written to {}\n", options.output);
+	return 0;
+}
@@ -1,22 +1,32 @@
 #include <chrono>
+#include <string>
 #include <eigen3/Eigen/Core>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
 #include <fmt/ranges.h>
 #include "NeuralNetwork.h"
 #include "Snake.h"
-#include "NeuroEvolution.h"
+#include "Checkpoint.h"
 #include "utils.h"
 
-int main()
+// Replays a network written by train, e.g. ./viewer snake.nn
+int main(int argc, char** argv)
 {
+	const std::string path = argc > 1 ? argv[1] : "snake.nn";
+	const checkpoint::Mapped file(path);
+	if(!file.valid())
+	{
+		fmt::print(stderr, "{}\n", file.error());
+		return 1;
+	}
+	const NeuralNetwork nn(file.network(0));
 	SnakeData sd;
-	std::uniform_int_distribution<uint32_t> pos(1, sd.data.rows()-2);
-	//const auto nn = NeuroEvolution::neuro_evolution(sd, 1000, 300, 0.5, 0.5, 10, 1000);
-	const auto nn = NeuroEvolution::neuro_evolution_steady(sd, 100000, 400, 0.5, 0.8, 10, 1000);
-	SnakeNN snake(pos(random::random_generator), pos(random::random_generator), nn);
+	sd.vision = nn.inputsCount() == Snake::vision_sensors;
+	std::uniform_int_distribution<uint32_t> pos_x(1, sd.width-2), pos_y(1, sd.height-2);
+	SnakeNN snake(pos_x(random::random_generator), pos_y(random::random_generator), nn);
+	sd.reset(snake);
 	snake.print = true;
-	fmt::print("Final NN layers {}, weights:\n", nn.layersCount());
+	fmt::print("Network {}, mean score {}, layers {}, weights:\n", path, file.fitnesses()[0], nn.layersCount());
 	for(const auto& layer : nn.weights) {
 		fmt::print("{}\n\n", layer);
 	}
@@ -57,9 +67,10 @@ int main()
 	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
 	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTextureStorage2D(texture, 1, GL_R8UI, sd.data.rows(), sd.data.cols());
+	glTextureStorage2D(texture, 1, GL_R8UI, sd.width, sd.height);
 	glBindTextureUnit(0, texture);
-	glTextureSubImage2D(texture, 0, 0, 0, sd.data.rows(), sd.data.cols(), GL_RED_INTEGER, GL_INT, sd.data.data());
+	const Eigen::ArrayXXi board = sd.flatDataDisplay(snake);
+	glTextureSubImage2D(texture, 0, 0, 0, board.rows(), board.cols(), GL_RED_INTEGER, GL_INT, board.data());
 
 	// VAO
 	GLuint vao;